@@ -37,6 +37,7 @@
 
 #include <libwnck/window-action-menu.h>
 #include <libwnck/util.h>
+#include <libwnck/resource-monitor.h>
 
 #include <libwnck/version.h>
 
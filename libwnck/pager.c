@@ -29,6 +29,12 @@
 #include <math.h>
 #include <glib/gi18n-lib.h>
 
+#ifdef HAVE_XCOMPOSITE
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/Xdamage.h>
+#include <cairo-xlib.h>
+#endif
+
 #include "pager.h"
 #include "workspace.h"
 #include "window.h"
@@ -61,6 +67,119 @@
 
 #define N_SCREEN_CONNECTIONS 11
 
+/* Colors used to draw a workspace and its windows in a given state, resolved
+ * once from the style */
+typedef struct
+{
+  GdkRGBA workspace_bg;
+  GdkRGBA window_bg;
+  GdkRGBA active_window_bg;
+  GdkRGBA fg;
+} WnckPagerColors;
+
+enum
+{
+  PAGER_COLORS_NORMAL,
+  PAGER_COLORS_PRELIGHT,
+  PAGER_COLORS_SELECTED,
+  N_PAGER_COLORS
+};
+
+/* Offscreen rendering of a workspace, only redrawn when something in the
+ * workspace changed, and the windows it contains */
+typedef struct
+{
+  cairo_surface_t *surface;
+  int              width;
+  int              height;
+  guint            dirty : 1;
+  cairo_region_t  *dirty_region; /* parts to redraw, when not all dirty */
+
+  GArray          *windows; /* WnckPagerWindowRect, from bottom to top */
+  int              windows_width;
+  int              windows_height;
+  guint            windows_dirty : 1;
+
+  PangoLayout     *name_layout; /* until the name or the font changes */
+} WnckPagerCachedWorkspace;
+
+typedef struct
+{
+  WnckWindow   *window;
+  GdkRectangle  rect; /* relative to the workspace */
+} WnckPagerWindowRect;
+
+/* Scaled down background of a screen, shared by all pagers on the screen. It
+ * is loaded in an idle callback, and the pagers are redrawn once it's ready.
+ */
+typedef struct
+{
+  WnckScreen *screen;
+  GSList     *pagers;
+
+  GdkPixbuf  *pixbuf;
+  int         width;  /* largest size wanted by a pager */
+  int         height;
+  guint       valid : 1;
+  guint       idle;
+} WnckPagerBackground;
+
+#define MIN_BG_SIZE 10
+
+/* Composite keeps a single redirection of a window per client, so the
+ * redirection and the damage of a window are shared by all the pagers of the
+ * screen that show its thumbnail */
+typedef struct
+{
+  guint   ref_count;
+  gulong  damage;
+  guint   failed : 1;
+} WnckPagerRedirect;
+
+/* Live miniature of a window in WNCK_PAGER_DISPLAY_THUMBNAILS mode: the window
+ * is redirected with the Composite extension, and the miniature is updated
+ * from the parts reported as damaged by the Damage extension. */
+typedef struct
+{
+  WnckWindow      *window;
+  gulong           damage; /* owned by the WnckPagerRedirect */
+  Visual          *visual;
+
+  cairo_surface_t *surface;
+  int              width;
+  int              height;
+  guint            frame; /* last draw where it was used */
+  GList           *lru_link;
+
+  GdkRectangle     damaged; /* in window coordinates */
+  guint            needs_update : 1;
+  guint            has_content : 1; /* the window has been viewable */
+  guint            failed : 1;
+} WnckPagerThumbnail;
+
+/* Limit on the memory used by the thumbnails of a pager, and on how often
+ * they are updated */
+#define THUMBNAILS_MEMORY_BUDGET (4 * 1024 * 1024)
+#define THUMBNAILS_UPDATE_INTERVAL 200 /* ms */
+
+/* Sizes of the window icons drawn in the pager: the icon of a window is
+ * scaled once to the biggest of these sizes that fits in the window, and
+ * kept until the icon changes */
+static const int pager_icon_sizes[] = { 8, 12, 16, 24, 32 };
+#define N_PAGER_ICON_SIZES G_N_ELEMENTS (pager_icon_sizes)
+
+typedef struct
+{
+  GdkPixbuf *icons[N_PAGER_ICON_SIZES];
+} WnckPagerIcons;
+
+/* Where a window was last drawn, relative to its workspace */
+typedef struct
+{
+  int          workspace;
+  GdkRectangle rect;
+} WnckPagerDrawnWindow;
+
 struct _WnckPagerPrivate
 {
   WnckScreen *screen;
@@ -83,6 +202,32 @@ struct _WnckPagerPrivate
 
   GdkPixbuf *bg_cache;
 
+  GArray *workspace_cache; /* WnckPagerCachedWorkspace, indexed by workspace */
+
+  GHashTable *thumbnails; /* WnckWindow -> WnckPagerThumbnail */
+  GQueue thumbnails_lru; /* most recently used first */
+  gsize thumbnails_memory;
+  guint thumbnails_frame;
+  guint thumbnails_update;
+  GHashTable *drawn_windows; /* WnckWindow -> WnckPagerDrawnWindow */
+  GHashTable *icons; /* WnckWindow -> WnckPagerIcons */
+
+  /* style properties, looked up again when the style changes */
+  guint style_valid : 1;
+  int focus_width;
+  GtkBorder padding;
+  WnckPagerColors colors[N_PAGER_COLORS];
+
+  /* geometry of the workspaces, computed again on size allocation */
+  guint workspace_rects_valid : 1;
+  GArray *workspace_rects; /* GdkRectangle, indexed by workspace */
+  int grid_x;
+  int grid_y;
+  int grid_columns;
+  int grid_rows;
+  int cell_width;
+  int cell_height;
+
   int layout_manager_token;
 
   guint dnd_activate; /* GSource that triggers switching to this workspace during dnd */
@@ -130,6 +275,9 @@ static void     wnck_pager_size_allocate (GtkWidget        *widget,
                                           GtkAllocation    *allocation);
 static gboolean wnck_pager_draw          (GtkWidget        *widget,
                                           cairo_t          *cr);
+static void     wnck_pager_style_updated (GtkWidget        *widget);
+static void     wnck_pager_state_flags_changed (GtkWidget     *widget,
+                                                GtkStateFlags  previous_state);
 static gboolean wnck_pager_button_press  (GtkWidget        *widget,
                                           GdkEventButton   *event);
 static gboolean wnck_pager_drag_motion   (GtkWidget        *widget,
@@ -182,6 +330,20 @@ static void wnck_pager_queue_draw_workspace   (WnckPager   *pager,
 					       gint	    i);
 static void wnck_pager_queue_draw_window (WnckPager	   *pager,
 					  WnckWindow	   *window);
+static void wnck_pager_queue_draw_window_content (WnckPager  *pager,
+                                                  WnckWindow *window);
+static void wnck_pager_queue_draw_all    (WnckPager        *pager);
+static void wnck_pager_invalidate_workspace (WnckPager     *pager,
+                                             gint           i);
+static void wnck_pager_invalidate_all    (WnckPager        *pager);
+static void wnck_pager_clear_workspace_cache (WnckPager    *pager);
+static void wnck_pager_clear_thumbnails  (WnckPager        *pager);
+static void wnck_pager_icons_free        (gpointer          data);
+static WnckPagerCachedWorkspace *wnck_pager_get_cached_workspace (WnckPager *pager,
+                                                                  int        workspace);
+static PangoLayout *wnck_pager_get_workspace_layout (WnckPager *pager,
+                                                     int        workspace);
+static void wnck_pager_clear_workspace_layouts (WnckPager *pager);
 
 static void wnck_pager_connect_screen    (WnckPager  *pager);
 static void wnck_pager_connect_window    (WnckPager  *pager,
@@ -236,6 +398,24 @@ wnck_pager_init (WnckPager *pager)
 
   pager->priv->bg_cache = NULL;
 
+  pager->priv->workspace_cache = g_array_new (FALSE, TRUE,
+                                              sizeof (WnckPagerCachedWorkspace));
+  pager->priv->drawn_windows = g_hash_table_new_full (NULL, NULL,
+                                                      NULL, g_free);
+  pager->priv->icons = g_hash_table_new_full (NULL, NULL,
+                                              NULL, wnck_pager_icons_free);
+
+  pager->priv->thumbnails = NULL;
+  g_queue_init (&pager->priv->thumbnails_lru);
+  pager->priv->thumbnails_memory = 0;
+  pager->priv->thumbnails_frame = 0;
+  pager->priv->thumbnails_update = 0;
+
+  pager->priv->style_valid = FALSE;
+  pager->priv->workspace_rects_valid = FALSE;
+  pager->priv->workspace_rects = g_array_new (FALSE, TRUE,
+                                              sizeof (GdkRectangle));
+
   pager->priv->layout_manager_token = WNCK_NO_MANAGER_TOKEN;
 
   pager->priv->dnd_activate = 0;
@@ -266,6 +446,8 @@ wnck_pager_class_init (WnckPagerClass *klass)
   widget_class->get_preferred_height_for_width = wnck_pager_get_preferred_height_for_width;
   widget_class->size_allocate = wnck_pager_size_allocate;
   widget_class->draw = wnck_pager_draw;
+  widget_class->style_updated = wnck_pager_style_updated;
+  widget_class->state_flags_changed = wnck_pager_state_flags_changed;
   widget_class->button_press_event = wnck_pager_button_press;
   widget_class->button_release_event = wnck_pager_button_release;
   widget_class->scroll_event = wnck_pager_scroll_event;
@@ -294,6 +476,21 @@ wnck_pager_finalize (GObject *object)
       pager->priv->bg_cache = NULL;
     }
 
+  wnck_pager_clear_thumbnails (pager);
+
+  wnck_pager_clear_workspace_cache (pager);
+  g_array_free (pager->priv->workspace_cache, TRUE);
+  pager->priv->workspace_cache = NULL;
+
+  g_hash_table_destroy (pager->priv->drawn_windows);
+  pager->priv->drawn_windows = NULL;
+
+  g_hash_table_destroy (pager->priv->icons);
+  pager->priv->icons = NULL;
+
+  g_array_free (pager->priv->workspace_rects, TRUE);
+  pager->priv->workspace_rects = NULL;
+
   if (pager->priv->dnd_activate != 0)
     {
       g_source_remove (pager->priv->dnd_activate);
@@ -332,6 +529,7 @@ _wnck_pager_set_screen (WnckPager *pager)
       else
         pager->priv->orientation = GTK_ORIENTATION_HORIZONTAL;
 
+      pager->priv->workspace_rects_valid = FALSE;
       gtk_widget_queue_resize (GTK_WIDGET (pager));
     }
 
@@ -398,12 +596,127 @@ wnck_pager_unrealize (GtkWidget *widget)
                                         pager->priv->layout_manager_token);
   pager->priv->layout_manager_token = WNCK_NO_MANAGER_TOKEN;
 
+  wnck_pager_clear_thumbnails (pager);
+
   wnck_pager_disconnect_screen (pager);
   pager->priv->screen = NULL;
 
+  /* the cached surfaces are similar to our GdkWindow */
+  wnck_pager_clear_workspace_cache (pager);
+
   GTK_WIDGET_CLASS (wnck_pager_parent_class)->unrealize (widget);
 }
 
+static void
+wnck_pager_style_updated (GtkWidget *widget)
+{
+  WnckPager *pager = WNCK_PAGER (widget);
+
+  if (GTK_WIDGET_CLASS (wnck_pager_parent_class)->style_updated)
+    GTK_WIDGET_CLASS (wnck_pager_parent_class)->style_updated (widget);
+
+  pager->priv->style_valid = FALSE;
+  pager->priv->workspace_rects_valid = FALSE;
+  /* the font might have changed */
+  wnck_pager_clear_workspace_layouts (pager);
+  wnck_pager_invalidate_all (pager);
+}
+
+static void
+wnck_pager_state_flags_changed (GtkWidget     *widget,
+                                GtkStateFlags  previous_state)
+{
+  WnckPager *pager = WNCK_PAGER (widget);
+
+  if (GTK_WIDGET_CLASS (wnck_pager_parent_class)->state_flags_changed)
+    GTK_WIDGET_CLASS (wnck_pager_parent_class)->state_flags_changed (widget,
+                                                                     previous_state);
+
+  /* the padding and the colors depend on the state */
+  pager->priv->style_valid = FALSE;
+  pager->priv->workspace_rects_valid = FALSE;
+  wnck_pager_invalidate_all (pager);
+}
+
+static void
+shade_color (const GdkRGBA *color,
+             gdouble        factor,
+             GdkRGBA       *shaded)
+{
+  GtkSymbolicColor *c1, *c2;
+
+  c1 = gtk_symbolic_color_new_literal (color);
+  c2 = gtk_symbolic_color_new_shade (c1, factor);
+  gtk_symbolic_color_resolve (c2, NULL, shaded);
+  gtk_symbolic_color_unref (c2);
+  gtk_symbolic_color_unref (c1);
+}
+
+static void
+get_colors_for_state (GtkStyleContext *context,
+                      GtkStateFlags    state,
+                      WnckPagerColors *colors)
+{
+  gtk_style_context_get_background_color (context, state, &colors->window_bg);
+  gtk_style_context_get_color (context, state, &colors->fg);
+
+  shade_color (&colors->window_bg, 0.7, &colors->workspace_bg);
+  shade_color (&colors->window_bg, 1.3, &colors->active_window_bg);
+}
+
+static void
+wnck_pager_update_style (WnckPager *pager)
+{
+  GtkStyleContext *context;
+
+  gtk_widget_style_get (GTK_WIDGET (pager),
+                        "focus-line-width", &pager->priv->focus_width,
+                        NULL);
+  _wnck_pager_get_padding (pager, &pager->priv->padding);
+
+  context = gtk_widget_get_style_context (GTK_WIDGET (pager));
+  get_colors_for_state (context, GTK_STATE_FLAG_NORMAL,
+                        &pager->priv->colors[PAGER_COLORS_NORMAL]);
+  get_colors_for_state (context, GTK_STATE_FLAG_PRELIGHT,
+                        &pager->priv->colors[PAGER_COLORS_PRELIGHT]);
+  get_colors_for_state (context, GTK_STATE_FLAG_SELECTED,
+                        &pager->priv->colors[PAGER_COLORS_SELECTED]);
+
+  pager->priv->style_valid = TRUE;
+}
+
+/* Returns the colors for a workspace in @state */
+static const WnckPagerColors *
+wnck_pager_get_colors (WnckPager     *pager,
+                       GtkStateFlags  state)
+{
+  if (!pager->priv->style_valid)
+    wnck_pager_update_style (pager);
+
+  if (state & GTK_STATE_FLAG_SELECTED)
+    return &pager->priv->colors[PAGER_COLORS_SELECTED];
+  else if (state & GTK_STATE_FLAG_PRELIGHT)
+    return &pager->priv->colors[PAGER_COLORS_PRELIGHT];
+  else
+    return &pager->priv->colors[PAGER_COLORS_NORMAL];
+}
+
+/* Returns the focus line width and the padding, without looking them up in
+ * the style each time. */
+static void
+wnck_pager_get_style_metrics (WnckPager *pager,
+                              int       *focus_width,
+                              GtkBorder *padding)
+{
+  if (!pager->priv->style_valid)
+    wnck_pager_update_style (pager);
+
+  if (focus_width)
+    *focus_width = pager->priv->focus_width;
+  if (padding)
+    *padding = pager->priv->padding;
+}
+
 static void
 _wnck_pager_get_padding (WnckPager *pager,
                          GtkBorder *padding)
@@ -432,7 +745,7 @@ _wnck_pager_get_workspace_width_for_height (WnckPager *pager,
 {
   int workspace_width = 0;
 
-  if (pager->priv->display_mode == WNCK_PAGER_DISPLAY_CONTENT)
+  if (pager->priv->display_mode != WNCK_PAGER_DISPLAY_NAME)
     {
       WnckWorkspace *space;
       double screen_aspect;
@@ -453,27 +766,19 @@ _wnck_pager_get_workspace_width_for_height (WnckPager *pager,
     }
   else
     {
-      PangoLayout *layout;
-      WnckScreen *screen;
       int n_spaces;
       int i, w;
 
-      layout = gtk_widget_create_pango_layout  (GTK_WIDGET (pager), NULL);
-      screen = pager->priv->screen;
       n_spaces = wnck_screen_get_workspace_count (pager->priv->screen);
       workspace_width = 1;
 
       for (i = 0; i < n_spaces; i++)
 	{
-	  pango_layout_set_text (layout,
-				 wnck_workspace_get_name (wnck_screen_get_workspace (screen, i)),
-				 -1);
-	  pango_layout_get_pixel_size (layout, &w, NULL);
+	  pango_layout_get_pixel_size (wnck_pager_get_workspace_layout (pager, i),
+	                               &w, NULL);
 	  workspace_width = MAX (workspace_width, w);
 	}
 
-      g_object_unref (layout);
-
       workspace_width += 2;
     }
 
@@ -742,13 +1047,12 @@ wnck_pager_size_allocate (GtkWidget      *widget,
 
   pager = WNCK_PAGER (widget);
 
-  gtk_widget_style_get (GTK_WIDGET (pager),
-			"focus-line-width", &focus_width,
-			NULL);
+  pager->priv->workspace_rects_valid = FALSE;
+
+  wnck_pager_get_style_metrics (pager, &focus_width, &padding);
   width  = allocation->width  - 2 * focus_width;
   height = allocation->height - 2 * focus_width;
 
-  _wnck_pager_get_padding (pager, &padding);
   width  -= padding.left + padding.right;
   height -= padding.top + padding.bottom;
 
@@ -778,19 +1082,24 @@ wnck_pager_size_allocate (GtkWidget      *widget,
       return;
     }
 
+  /* workspace sizes or positions might have changed */
+  wnck_pager_invalidate_all (pager);
+
   GTK_WIDGET_CLASS (wnck_pager_parent_class)->size_allocate (widget,
                                                              allocation);
 }
 
+/* Computes the rectangles of all workspaces, as well as the grid they form
+ * so that we can find the workspace at a given point without going through
+ * all of them. */
 static void
-get_workspace_rect (WnckPager    *pager,
-                    int           space,
-                    GdkRectangle *rect)
+wnck_pager_update_workspace_rects (WnckPager *pager)
 {
   int hsize, vsize;
   int n_spaces;
   int spaces_per_row;
   GtkWidget *widget;
+  int space;
   int col, row;
   GtkAllocation allocation;
   GtkBorder padding;
@@ -799,99 +1108,134 @@ get_workspace_rect (WnckPager    *pager,
   widget = GTK_WIDGET (pager);
 
   gtk_widget_get_allocation (widget, &allocation);
-
-  _wnck_pager_get_padding (pager, &padding);
-  gtk_widget_style_get (widget,
-			"focus-line-width", &focus_width,
-			NULL);
-
-  if (!pager->priv->show_all_workspaces)
-    {
-      WnckWorkspace *active_space;
-
-      active_space = wnck_screen_get_active_workspace (pager->priv->screen);
-
-      if (active_space && space == wnck_workspace_get_number (active_space))
-	{
-	  rect->x = focus_width + padding.left;
-	  rect->y = focus_width + padding.top;
-	  rect->width = allocation.width - 2 * focus_width - padding.left - padding.right;
-	  rect->height = allocation.height - 2 * focus_width - padding.top - padding.bottom;
-	}
-      else
-	{
-	  rect->x = 0;
-	  rect->y = 0;
-	  rect->width = 0;
-	  rect->height = 0;
-	}
-
-      return;
-    }
+  wnck_pager_get_style_metrics (pager, &focus_width, &padding);
 
   hsize = allocation.width - 2 * focus_width;
   vsize = allocation.height - 2 * focus_width;
 
+  pager->priv->grid_x = focus_width;
+  pager->priv->grid_y = focus_width;
+
   if (pager->priv->shadow_type != GTK_SHADOW_NONE)
     {
       hsize -= padding.left + padding.right;
       vsize -= padding.top + padding.bottom;
+
+      pager->priv->grid_x += padding.left;
+      pager->priv->grid_y += padding.top;
     }
 
   n_spaces = wnck_screen_get_workspace_count (pager->priv->screen);
 
   g_assert (pager->priv->n_rows > 0);
   spaces_per_row = (n_spaces + pager->priv->n_rows - 1) / pager->priv->n_rows;
+  spaces_per_row = MAX (spaces_per_row, 1);
 
   if (pager->priv->orientation == GTK_ORIENTATION_VERTICAL)
     {
-      rect->width = (hsize - (pager->priv->n_rows - 1)) / pager->priv->n_rows;
-      rect->height = (vsize - (spaces_per_row - 1)) / spaces_per_row;
+      pager->priv->grid_columns = pager->priv->n_rows;
+      pager->priv->grid_rows = spaces_per_row;
+    }
+  else
+    {
+      pager->priv->grid_columns = spaces_per_row;
+      pager->priv->grid_rows = pager->priv->n_rows;
+    }
+
+  pager->priv->cell_width = (hsize - (pager->priv->grid_columns - 1)) / pager->priv->grid_columns;
+  pager->priv->cell_height = (vsize - (pager->priv->grid_rows - 1)) / pager->priv->grid_rows;
+
+  g_array_set_size (pager->priv->workspace_rects, n_spaces);
+
+  for (space = 0; space < n_spaces; space++)
+    {
+      GdkRectangle *rect;
 
-      col = space / spaces_per_row;
-      row = space % spaces_per_row;
+      rect = &g_array_index (pager->priv->workspace_rects, GdkRectangle, space);
+
+      if (pager->priv->orientation == GTK_ORIENTATION_VERTICAL)
+        {
+          col = space / spaces_per_row;
+          row = space % spaces_per_row;
+        }
+      else
+        {
+          col = space % spaces_per_row;
+          row = space / spaces_per_row;
+        }
 
       if (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL)
-        col = pager->priv->n_rows - col - 1;
+        col = pager->priv->grid_columns - col - 1;
+
+      rect->width = pager->priv->cell_width;
+      rect->height = pager->priv->cell_height;
 
       rect->x = (rect->width + 1) * col;
       rect->y = (rect->height + 1) * row;
 
-      if (col == pager->priv->n_rows - 1)
+      if (col == pager->priv->grid_columns - 1)
 	rect->width = hsize - rect->x;
 
-      if (row  == spaces_per_row - 1)
+      if (row == pager->priv->grid_rows - 1)
 	rect->height = vsize - rect->y;
+
+      rect->x += pager->priv->grid_x;
+      rect->y += pager->priv->grid_y;
     }
-  else
+
+  pager->priv->workspace_rects_valid = TRUE;
+}
+
+static void
+get_workspace_rect (WnckPager    *pager,
+                    int           space,
+                    GdkRectangle *rect)
+{
+  if (!pager->priv->show_all_workspaces)
     {
-      rect->width = (hsize - (spaces_per_row - 1)) / spaces_per_row;
-      rect->height = (vsize - (pager->priv->n_rows - 1)) / pager->priv->n_rows;
+      WnckWorkspace *active_space;
 
-      col = space % spaces_per_row;
-      row = space / spaces_per_row;
+      active_space = wnck_screen_get_active_workspace (pager->priv->screen);
 
-      if (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL)
-        col = spaces_per_row - col - 1;
+      if (active_space && space == wnck_workspace_get_number (active_space))
+	{
+          GtkAllocation allocation;
+          GtkBorder padding;
+          int focus_width;
 
-      rect->x = (rect->width + 1) * col;
-      rect->y = (rect->height + 1) * row;
+          gtk_widget_get_allocation (GTK_WIDGET (pager), &allocation);
+          wnck_pager_get_style_metrics (pager, &focus_width, &padding);
 
-      if (col == spaces_per_row - 1)
-	rect->width = hsize - rect->x;
+	  rect->x = focus_width + padding.left;
+	  rect->y = focus_width + padding.top;
+	  rect->width = allocation.width - 2 * focus_width - padding.left - padding.right;
+	  rect->height = allocation.height - 2 * focus_width - padding.top - padding.bottom;
+	}
+      else
+	{
+	  rect->x = 0;
+	  rect->y = 0;
+	  rect->width = 0;
+	  rect->height = 0;
+	}
 
-      if (row  == pager->priv->n_rows - 1)
-	rect->height = vsize - rect->y;
+      return;
     }
 
-  rect->x += focus_width;
-  rect->y += focus_width;
+  if (!pager->priv->workspace_rects_valid ||
+      pager->priv->workspace_rects->len != (guint) wnck_screen_get_workspace_count (pager->priv->screen))
+    wnck_pager_update_workspace_rects (pager);
 
-  if (pager->priv->shadow_type != GTK_SHADOW_NONE)
+  if (space < 0 || (guint) space >= pager->priv->workspace_rects->len)
     {
-      rect->x += padding.left;
-      rect->y += padding.top;
+      rect->x = 0;
+      rect->y = 0;
+      rect->width = 0;
+      rect->height = 0;
+      return;
     }
+
+  *rect = g_array_index (pager->priv->workspace_rects, GdkRectangle, space);
 }
 
 static gboolean
@@ -986,139 +1330,837 @@ get_window_rect (WnckWindow         *window,
 }
 
 static void
-draw_window (cairo_t            *cr,
-             GtkWidget          *widget,
-             WnckWindow         *win,
-             const GdkRectangle *winrect,
-             GtkStateFlags       state,
-             gboolean            translucent)
+wnck_pager_set_drawn_window_rect (WnckPager          *pager,
+                                  WnckWindow         *window,
+                                  int                 workspace,
+                                  const GdkRectangle *workspace_rect,
+                                  const GdkRectangle *winrect)
 {
-  GtkStyleContext *context;
-  GdkPixbuf *icon;
-  int icon_x, icon_y, icon_w, icon_h;
-  gboolean is_active;
-  GdkRGBA bg, fg;
-  gdouble translucency;
+  WnckPagerDrawnWindow *drawn;
 
-  context = gtk_widget_get_style_context (widget);
+  drawn = g_hash_table_lookup (pager->priv->drawn_windows, window);
+  if (drawn == NULL)
+    {
+      drawn = g_new (WnckPagerDrawnWindow, 1);
+      g_hash_table_insert (pager->priv->drawn_windows, window, drawn);
+    }
 
-  is_active = wnck_window_is_active (win);
-  translucency = translucent ? 0.4 : 1.0;
+  drawn->workspace = workspace;
+  drawn->rect = *winrect;
+  drawn->rect.x -= workspace_rect->x;
+  drawn->rect.y -= workspace_rect->y;
+}
 
-  cairo_save (cr);
-  cairo_rectangle (cr, winrect->x, winrect->y, winrect->width, winrect->height);
-  cairo_clip (cr);
+#ifdef HAVE_XCOMPOSITE
+typedef struct
+{
+  gboolean have_extensions;
+  int      damage_event_base;
+} WnckPagerExtensions;
 
-  gtk_style_context_get_background_color (context, state, &bg);
-  if (is_active) {
-    GtkSymbolicColor *c1, *c2;
+static gboolean
+have_composite_and_damage (Display *xdisplay,
+                           int     *damage_event_base)
+{
+  GdkDisplay *gdkdisplay;
+  WnckPagerExtensions *extensions;
 
-    c1 = gtk_symbolic_color_new_literal (&bg);
-    c2 = gtk_symbolic_color_new_shade (c1, 1.3);
-    gtk_symbolic_color_resolve (c2, NULL, &bg);
-    gtk_symbolic_color_unref (c2);
-    gtk_symbolic_color_unref (c1);
-  }
+  gdkdisplay = gdk_x11_lookup_xdisplay (xdisplay);
+  if (gdkdisplay == NULL)
+    return FALSE;
 
-  bg.alpha = translucency;
-  gdk_cairo_set_source_rgba (cr, &bg);
-  cairo_rectangle (cr,
-                   winrect->x + 1, winrect->y + 1,
-                   MAX (0, winrect->width - 2), MAX (0, winrect->height - 2));
-  cairo_fill (cr);
+  extensions = g_object_get_data (G_OBJECT (gdkdisplay),
+                                  "wnck-pager-extensions");
 
-  icon = wnck_window_get_icon (win);
+  if (extensions == NULL)
+    {
+      int composite_event_base, error_base;
+      int major, minor;
+
+      extensions = g_new0 (WnckPagerExtensions, 1);
+
+      /* we need at least 0.2 for XCompositeNameWindowPixmap() */
+      if (XCompositeQueryExtension (xdisplay,
+                                    &composite_event_base, &error_base) &&
+          XCompositeQueryVersion (xdisplay, &major, &minor) &&
+          (major > 0 || minor >= 2) &&
+          XDamageQueryExtension (xdisplay,
+                                 &extensions->damage_event_base,
+                                 &error_base))
+        extensions->have_extensions = TRUE;
+
+      g_object_set_data_full (G_OBJECT (gdkdisplay), "wnck-pager-extensions",
+                              extensions, g_free);
+    }
 
-  icon_w = icon_h = 0;
+  if (damage_event_base)
+    *damage_event_base = extensions->damage_event_base;
 
-  if (icon)
-    {
-      icon_w = gdk_pixbuf_get_width (icon);
-      icon_h = gdk_pixbuf_get_height (icon);
+  return extensions->have_extensions;
+}
 
-      /* If the icon is too big, fall back to mini icon.
-       * We don't arbitrarily scale the icon, because it's
-       * just too slow on my Athlon 850.
-       */
-      if (icon_w > (winrect->width - 2) ||
-          icon_h > (winrect->height - 2))
-        {
-          icon = wnck_window_get_mini_icon (win);
-          if (icon)
-            {
-              icon_w = gdk_pixbuf_get_width (icon);
-              icon_h = gdk_pixbuf_get_height (icon);
+static void
+wnck_pager_redirect_free (gpointer data)
+{
+  g_slice_free (WnckPagerRedirect, data);
+}
 
-              /* Give up. */
-              if (icon_w > (winrect->width - 2) ||
-                  icon_h > (winrect->height - 2))
-                icon = NULL;
-            }
-        }
-    }
+static GHashTable *
+wnck_pager_get_redirects (WnckScreen *screen)
+{
+  GHashTable *redirects;
 
-  if (icon)
-    {
-      icon_x = winrect->x + (winrect->width - icon_w) / 2;
-      icon_y = winrect->y + (winrect->height - icon_h) / 2;
+  redirects = g_object_get_data (G_OBJECT (screen), "wnck-pager-redirects");
 
-      cairo_save (cr);
-      gdk_cairo_set_source_pixbuf (cr, icon, icon_x, icon_y);
-      cairo_rectangle (cr, icon_x, icon_y, icon_w, icon_h);
-      cairo_clip (cr);
-      cairo_paint_with_alpha (cr, translucency);
-      cairo_restore (cr);
+  if (redirects == NULL)
+    {
+      redirects = g_hash_table_new_full (NULL, NULL,
+                                         NULL, wnck_pager_redirect_free);
+      g_object_set_data_full (G_OBJECT (screen), "wnck-pager-redirects",
+                              redirects,
+                              (GDestroyNotify) g_hash_table_destroy);
     }
 
-  gtk_style_context_get_color (context, state, &fg);
-  fg.alpha = translucency;
-  gdk_cairo_set_source_rgba (cr, &fg);
-  cairo_set_line_width (cr, 1.0);
-  cairo_rectangle (cr,
-                   winrect->x + 0.5, winrect->y + 0.5,
-                   MAX (0, winrect->width - 1), MAX (0, winrect->height - 1));
-  cairo_stroke (cr);
-
-  cairo_restore (cr);
+  return redirects;
 }
 
-static WnckWindow *
-window_at_point (WnckPager     *pager,
-                 WnckWorkspace *space,
-                 GdkRectangle  *space_rect,
-                 int            x,
-                 int            y)
+/* Redirects @window and follows its damage, unless another pager already
+ * does */
+static WnckPagerRedirect *
+wnck_pager_redirect_ref (WnckScreen *screen,
+                         WnckWindow *window)
 {
-  WnckWindow *window;
-  GList *windows;
-  GList *tmp;
+  GHashTable *redirects;
+  WnckPagerRedirect *redirect;
+  Display *xdisplay;
+  Window xwindow;
 
-  window = NULL;
+  redirects = wnck_pager_get_redirects (screen);
 
-  windows = get_windows_for_workspace_in_bottom_to_top (pager->priv->screen,
-                                                        space);
+  redirect = g_hash_table_lookup (redirects, window);
+  if (redirect)
+    {
+      redirect->ref_count++;
+      return redirect;
+    }
 
-  /* clicks on top windows first */
-  windows = g_list_reverse (windows);
+  xdisplay = DisplayOfScreen (WNCK_SCREEN_XSCREEN (screen));
+  xwindow = wnck_window_get_xid (window);
+
+  redirect = g_slice_new0 (WnckPagerRedirect);
+  redirect->ref_count = 1;
+
+  /* the redirection is checked on its own, so that we never remove a
+   * redirection we did not get */
+  _wnck_error_trap_push (xdisplay);
+  XCompositeRedirectWindow (xdisplay, xwindow, CompositeRedirectAutomatic);
+  if (_wnck_error_trap_pop (xdisplay))
+    redirect->failed = TRUE;
+  else
+    {
+      _wnck_error_trap_push (xdisplay);
+      redirect->damage = XDamageCreate (xdisplay, xwindow,
+                                        XDamageReportBoundingBox);
+      if (_wnck_error_trap_pop (xdisplay))
+        {
+          _wnck_error_trap_push (xdisplay);
+          XCompositeUnredirectWindow (xdisplay, xwindow,
+                                      CompositeRedirectAutomatic);
+          _wnck_error_trap_pop_ignored (xdisplay);
+
+          redirect->failed = TRUE;
+        }
+    }
+
+  g_hash_table_insert (redirects, window, redirect);
+
+  return redirect;
+}
+
+/* Stops redirecting @window when the last pager showing it lets it go */
+static void
+wnck_pager_redirect_unref (WnckScreen *screen,
+                           WnckWindow *window)
+{
+  GHashTable *redirects;
+  WnckPagerRedirect *redirect;
+  Display *xdisplay;
+
+  redirects = wnck_pager_get_redirects (screen);
+
+  redirect = g_hash_table_lookup (redirects, window);
+  if (redirect == NULL)
+    return;
+
+  if (--redirect->ref_count > 0)
+    return;
+
+  if (!redirect->failed)
+    {
+      xdisplay = DisplayOfScreen (WNCK_SCREEN_XSCREEN (screen));
+
+      /* the window might be gone already */
+      _wnck_error_trap_push (xdisplay);
+      XDamageDestroy (xdisplay, redirect->damage);
+      XCompositeUnredirectWindow (xdisplay, wnck_window_get_xid (window),
+                                  CompositeRedirectAutomatic);
+      _wnck_error_trap_pop_ignored (xdisplay);
+    }
+
+  g_hash_table_remove (redirects, window);
+}
+
+static gboolean
+wnck_pager_update_thumbnails (gpointer data);
+
+static GdkFilterReturn
+wnck_pager_thumbnails_filter (GdkXEvent *gdkxevent,
+                              GdkEvent  *event,
+                              gpointer   data)
+{
+  WnckPager *pager = WNCK_PAGER (data);
+  XEvent *xevent = gdkxevent;
+  XDamageNotifyEvent *damage_event;
+  WnckPagerThumbnail *thumbnail;
+  WnckWindow *window;
+  GdkRectangle area;
+  int damage_event_base;
+
+  if (!have_composite_and_damage (xevent->xany.display, &damage_event_base) ||
+      xevent->type != damage_event_base + XDamageNotify)
+    return GDK_FILTER_CONTINUE;
+
+  damage_event = (XDamageNotifyEvent *) xevent;
+
+  window = wnck_window_get (damage_event->drawable);
+  if (window == NULL)
+    return GDK_FILTER_CONTINUE;
+
+  thumbnail = g_hash_table_lookup (pager->priv->thumbnails, window);
+  if (thumbnail == NULL || thumbnail->damage != damage_event->damage)
+    return GDK_FILTER_CONTINUE;
+
+  area.x = damage_event->area.x;
+  area.y = damage_event->area.y;
+  area.width = damage_event->area.width;
+  area.height = damage_event->area.height;
+
+  if (thumbnail->needs_update)
+    gdk_rectangle_union (&thumbnail->damaged, &area, &thumbnail->damaged);
+  else
+    thumbnail->damaged = area;
+
+  thumbnail->needs_update = TRUE;
+  thumbnail->has_content = TRUE;
+
+  /* damaged windows are only updated every THUMBNAILS_UPDATE_INTERVAL */
+  if (pager->priv->thumbnails_update == 0)
+    pager->priv->thumbnails_update = g_timeout_add (THUMBNAILS_UPDATE_INTERVAL,
+                                                    wnck_pager_update_thumbnails,
+                                                    pager);
+
+  /* other pagers might show the same window */
+  return GDK_FILTER_CONTINUE;
+}
+
+static void
+wnck_pager_thumbnail_free_surface (WnckPager          *pager,
+                                   WnckPagerThumbnail *thumbnail)
+{
+  if (thumbnail->surface == NULL)
+    return;
+
+  cairo_surface_destroy (thumbnail->surface);
+  thumbnail->surface = NULL;
+
+  pager->priv->thumbnails_memory -= thumbnail->width * thumbnail->height * 4;
+}
+
+static void
+wnck_pager_thumbnail_destroy (WnckPager          *pager,
+                              WnckPagerThumbnail *thumbnail)
+{
+  wnck_pager_thumbnail_free_surface (pager, thumbnail);
+  g_queue_delete_link (&pager->priv->thumbnails_lru, thumbnail->lru_link);
+
+  wnck_pager_redirect_unref (pager->priv->screen, thumbnail->window);
+
+  g_slice_free (WnckPagerThumbnail, thumbnail);
+}
+
+/* Copies the damaged part of the window, or all of it, to the thumbnail. The
+ * scaling is done by the X server. */
+static void
+wnck_pager_thumbnail_update (WnckPager          *pager,
+                             WnckPagerThumbnail *thumbnail,
+                             gboolean            full)
+{
+  Display *xdisplay;
+  Window xwindow;
+  Pixmap xpixmap;
+  cairo_surface_t *source;
+  cairo_t *cr;
+  int width, height;
+  double x_ratio, y_ratio;
+
+  wnck_window_get_client_window_geometry (thumbnail->window,
+                                          NULL, NULL, &width, &height);
+  if (width <= 0 || height <= 0)
+    return;
+
+  xdisplay = DisplayOfScreen (WNCK_SCREEN_XSCREEN (pager->priv->screen));
+  xwindow = wnck_window_get_xid (thumbnail->window);
+
+  _wnck_error_trap_push (xdisplay);
+
+  /* Reset the damage before getting the content, so that we don't miss
+   * anything */
+  XDamageSubtract (xdisplay, thumbnail->damage, None, None);
+
+  xpixmap = XCompositeNameWindowPixmap (xdisplay, xwindow);
+  source = cairo_xlib_surface_create (xdisplay, xpixmap, thumbnail->visual,
+                                      width, height);
+
+  x_ratio = (double) thumbnail->width / width;
+  y_ratio = (double) thumbnail->height / height;
+
+  cr = cairo_create (thumbnail->surface);
+
+  if (!full)
+    {
+      /* one more pixel on each side, because of the filtering */
+      cairo_rectangle (cr,
+                       floor (thumbnail->damaged.x * x_ratio) - 1,
+                       floor (thumbnail->damaged.y * y_ratio) - 1,
+                       ceil (thumbnail->damaged.width * x_ratio) + 2,
+                       ceil (thumbnail->damaged.height * y_ratio) + 2);
+      cairo_clip (cr);
+    }
+
+  cairo_scale (cr, x_ratio, y_ratio);
+  cairo_set_source_surface (cr, source, 0, 0);
+  cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  cairo_surface_destroy (source);
+  XFreePixmap (xdisplay, xpixmap);
+
+  _wnck_error_trap_pop_ignored (xdisplay);
+
+  thumbnail->needs_update = FALSE;
+}
+
+static gboolean
+wnck_pager_update_thumbnails (gpointer data)
+{
+  WnckPager *pager = WNCK_PAGER (data);
+  GList *l;
+
+  pager->priv->thumbnails_update = 0;
+
+  for (l = pager->priv->thumbnails_lru.head; l != NULL; l = l->next)
+    {
+      WnckPagerThumbnail *thumbnail = l->data;
+
+      if (!thumbnail->needs_update)
+        continue;
+
+      /* without a surface, it will be created when drawing the window */
+      if (thumbnail->surface)
+        wnck_pager_thumbnail_update (pager, thumbnail, FALSE);
+      wnck_pager_queue_draw_window_content (pager, thumbnail->window);
+    }
+
+  return FALSE;
+}
+
+/* Makes room for @size more bytes of thumbnails, by freeing the least
+ * recently used thumbnails that were not used in the current draw */
+static gboolean
+wnck_pager_thumbnails_reserve (WnckPager *pager,
+                               gsize      size)
+{
+  GList *l;
+
+  if (size > THUMBNAILS_MEMORY_BUDGET)
+    return FALSE;
+
+  l = pager->priv->thumbnails_lru.tail;
+  while (l != NULL &&
+         pager->priv->thumbnails_memory + size > THUMBNAILS_MEMORY_BUDGET)
+    {
+      WnckPagerThumbnail *thumbnail = l->data;
+
+      l = l->prev;
+
+      if (thumbnail->frame == pager->priv->thumbnails_frame)
+        break;
+
+      wnck_pager_thumbnail_free_surface (pager, thumbnail);
+    }
+
+  return pager->priv->thumbnails_memory + size <= THUMBNAILS_MEMORY_BUDGET;
+}
+
+static WnckPagerThumbnail *
+wnck_pager_thumbnail_new (WnckPager  *pager,
+                          WnckWindow *window)
+{
+  WnckPagerThumbnail *thumbnail;
+  WnckPagerRedirect *redirect;
+  XWindowAttributes attrs;
+  Display *xdisplay;
+  Window xwindow;
+
+  xdisplay = DisplayOfScreen (WNCK_SCREEN_XSCREEN (pager->priv->screen));
+  xwindow = wnck_window_get_xid (window);
+
+  thumbnail = g_slice_new0 (WnckPagerThumbnail);
+  thumbnail->window = window;
+
+  /* released when the thumbnail is destroyed, even if it failed */
+  redirect = wnck_pager_redirect_ref (pager->priv->screen, window);
+  thumbnail->damage = redirect->damage;
+
+  if (!redirect->failed)
+    {
+      _wnck_error_trap_push (xdisplay);
+      if (XGetWindowAttributes (xdisplay, xwindow, &attrs))
+        {
+          thumbnail->visual = attrs.visual;
+          /* windows on other workspaces are usually unmapped, and we have
+           * nothing to show until they get mapped */
+          thumbnail->has_content = (attrs.map_state == IsViewable);
+        }
+      if (_wnck_error_trap_pop (xdisplay))
+        thumbnail->visual = NULL;
+    }
+
+  /* we'll just draw the icon of this window */
+  if (redirect->failed || thumbnail->visual == NULL)
+    thumbnail->failed = TRUE;
+
+  if (g_hash_table_size (pager->priv->thumbnails) == 0)
+    gdk_window_add_filter (NULL, wnck_pager_thumbnails_filter, pager);
+
+  g_hash_table_insert (pager->priv->thumbnails, window, thumbnail);
+
+  g_queue_push_head (&pager->priv->thumbnails_lru, thumbnail);
+  thumbnail->lru_link = pager->priv->thumbnails_lru.head;
+
+  return thumbnail;
+}
+#endif /* HAVE_XCOMPOSITE */
+
+/* Returns the live thumbnail of @window at the given size, or NULL if there's
+ * none and the icon should be drawn instead */
+static cairo_surface_t *
+wnck_pager_get_thumbnail (WnckPager  *pager,
+                          WnckWindow *window,
+                          int         width,
+                          int         height)
+{
+#ifdef HAVE_XCOMPOSITE
+  WnckPagerThumbnail *thumbnail;
+  gsize size;
+
+  if (pager->priv->display_mode != WNCK_PAGER_DISPLAY_THUMBNAILS ||
+      width <= 0 || height <= 0)
+    return NULL;
+
+  if (!have_composite_and_damage (DisplayOfScreen (WNCK_SCREEN_XSCREEN (pager->priv->screen)),
+                                  NULL))
+    return NULL;
+
+  if (pager->priv->thumbnails == NULL)
+    pager->priv->thumbnails = g_hash_table_new (NULL, NULL);
+
+  thumbnail = g_hash_table_lookup (pager->priv->thumbnails, window);
+  if (thumbnail == NULL)
+    thumbnail = wnck_pager_thumbnail_new (pager, window);
+
+  if (thumbnail->failed || !thumbnail->has_content)
+    return NULL;
+
+  thumbnail->frame = pager->priv->thumbnails_frame;
+  g_queue_unlink (&pager->priv->thumbnails_lru, thumbnail->lru_link);
+  g_queue_push_head_link (&pager->priv->thumbnails_lru, thumbnail->lru_link);
+
+  if (thumbnail->surface == NULL ||
+      thumbnail->width != width || thumbnail->height != height)
+    {
+      wnck_pager_thumbnail_free_surface (pager, thumbnail);
+
+      size = width * height * 4;
+      if (!wnck_pager_thumbnails_reserve (pager, size))
+        return NULL;
+
+      thumbnail->surface =
+        gdk_window_create_similar_surface (gtk_widget_get_window (GTK_WIDGET (pager)),
+                                           CAIRO_CONTENT_COLOR,
+                                           width, height);
+      thumbnail->width = width;
+      thumbnail->height = height;
+      pager->priv->thumbnails_memory += size;
+
+      wnck_pager_thumbnail_update (pager, thumbnail, TRUE);
+    }
+
+  return thumbnail->surface;
+#else
+  return NULL;
+#endif
+}
+
+static void
+wnck_pager_remove_thumbnail (WnckPager  *pager,
+                             WnckWindow *window)
+{
+#ifdef HAVE_XCOMPOSITE
+  WnckPagerThumbnail *thumbnail;
+
+  if (pager->priv->thumbnails == NULL)
+    return;
+
+  thumbnail = g_hash_table_lookup (pager->priv->thumbnails, window);
+  if (thumbnail == NULL)
+    return;
+
+  g_hash_table_remove (pager->priv->thumbnails, window);
+  wnck_pager_thumbnail_destroy (pager, thumbnail);
+
+  if (g_hash_table_size (pager->priv->thumbnails) == 0)
+    gdk_window_remove_filter (NULL, wnck_pager_thumbnails_filter, pager);
+#endif
+}
+
+static void
+wnck_pager_clear_thumbnails (WnckPager *pager)
+{
+#ifdef HAVE_XCOMPOSITE
+  if (pager->priv->thumbnails_update != 0)
+    {
+      g_source_remove (pager->priv->thumbnails_update);
+      pager->priv->thumbnails_update = 0;
+    }
+
+  if (pager->priv->thumbnails == NULL)
+    return;
+
+  if (g_hash_table_size (pager->priv->thumbnails) > 0)
+    gdk_window_remove_filter (NULL, wnck_pager_thumbnails_filter, pager);
+
+  while (pager->priv->thumbnails_lru.head != NULL)
+    {
+      WnckPagerThumbnail *thumbnail = pager->priv->thumbnails_lru.head->data;
+
+      g_hash_table_remove (pager->priv->thumbnails, thumbnail->window);
+      wnck_pager_thumbnail_destroy (pager, thumbnail);
+    }
+
+  g_hash_table_destroy (pager->priv->thumbnails);
+  pager->priv->thumbnails = NULL;
+#endif
+}
+
+static void
+wnck_pager_icons_free (gpointer data)
+{
+  WnckPagerIcons *icons = data;
+  guint i;
+
+  for (i = 0; i < N_PAGER_ICON_SIZES; i++)
+    if (icons->icons[i])
+      g_object_unref (icons->icons[i]);
+
+  g_slice_free (WnckPagerIcons, icons);
+}
+
+/* Returns the icon of @window at the biggest size that fits in
+ * @max_width x @max_height, scaling it only the first time it is needed */
+static GdkPixbuf *
+wnck_pager_get_icon (WnckPager  *pager,
+                     WnckWindow *window,
+                     int         max_width,
+                     int         max_height)
+{
+  WnckPagerIcons *icons;
+  GdkPixbuf *source;
+  int size, width, height;
+  int i;
+
+  for (i = N_PAGER_ICON_SIZES - 1; i >= 0; i--)
+    if (pager_icon_sizes[i] <= max_width && pager_icon_sizes[i] <= max_height)
+      break;
+
+  if (i < 0)
+    return NULL;
+
+  icons = g_hash_table_lookup (pager->priv->icons, window);
+  if (icons == NULL)
+    {
+      icons = g_slice_new0 (WnckPagerIcons);
+      g_hash_table_insert (pager->priv->icons, window, icons);
+    }
+
+  if (icons->icons[i])
+    return icons->icons[i];
+
+  size = pager_icon_sizes[i];
+
+  /* the mini icon is often drawn for its size, prefer it when it's big
+   * enough */
+  source = wnck_window_get_mini_icon (window);
+  if (source == NULL ||
+      (gdk_pixbuf_get_width (source) < size &&
+       gdk_pixbuf_get_height (source) < size))
+    source = wnck_window_get_icon (window);
+  if (source == NULL)
+    return NULL;
+
+  width = gdk_pixbuf_get_width (source);
+  height = gdk_pixbuf_get_height (source);
+
+  if (width <= size && height <= size)
+    icons->icons[i] = g_object_ref (source);
+  else
+    {
+      double scale;
+
+      scale = (double) size / MAX (width, height);
+      icons->icons[i] = gdk_pixbuf_scale_simple (source,
+                                                 MAX (1, width * scale + 0.5),
+                                                 MAX (1, height * scale + 0.5),
+                                                 GDK_INTERP_HYPER);
+    }
+
+  return icons->icons[i];
+}
+
+/* Returns the icon or the mini icon of @window if one of them fits in
+ * @max_width x @max_height, without scaling it */
+static GdkPixbuf *
+get_unscaled_icon (WnckWindow *window,
+                   int         max_width,
+                   int         max_height)
+{
+  GdkPixbuf *icon;
+
+  icon = wnck_window_get_icon (window);
+  if (icon &&
+      gdk_pixbuf_get_width (icon) <= max_width &&
+      gdk_pixbuf_get_height (icon) <= max_height)
+    return icon;
+
+  icon = wnck_window_get_mini_icon (window);
+  if (icon &&
+      gdk_pixbuf_get_width (icon) <= max_width &&
+      gdk_pixbuf_get_height (icon) <= max_height)
+    return icon;
+
+  return NULL;
+}
+
+static void
+draw_window (cairo_t               *cr,
+             WnckWindow            *win,
+             const GdkRectangle    *winrect,
+             const WnckPagerColors *colors,
+             gboolean               translucent,
+             cairo_surface_t       *thumbnail,
+             GdkPixbuf             *icon)
+{
+  int icon_x, icon_y, icon_w, icon_h;
+  gboolean is_active;
+  GdkRGBA bg, fg;
+  gdouble translucency;
+
+  is_active = wnck_window_is_active (win);
+  translucency = translucent ? 0.4 : 1.0;
+
+  cairo_save (cr);
+  cairo_rectangle (cr, winrect->x, winrect->y, winrect->width, winrect->height);
+  cairo_clip (cr);
+
+  if (is_active)
+    bg = colors->active_window_bg;
+  else
+    bg = colors->window_bg;
+
+  bg.alpha = translucency;
+  gdk_cairo_set_source_rgba (cr, &bg);
+  cairo_rectangle (cr,
+                   winrect->x + 1, winrect->y + 1,
+                   MAX (0, winrect->width - 2), MAX (0, winrect->height - 2));
+
+  if (thumbnail)
+    {
+      /* the thumbnail has the size of the inside of the window */
+      cairo_set_source_surface (cr, thumbnail, winrect->x + 1, winrect->y + 1);
+      cairo_save (cr);
+      cairo_clip (cr);
+      cairo_paint_with_alpha (cr, translucency);
+      cairo_restore (cr);
+
+      icon = NULL;
+    }
+  else
+    cairo_fill (cr);
+
+  if (icon)
+    {
+      icon_w = gdk_pixbuf_get_width (icon);
+      icon_h = gdk_pixbuf_get_height (icon);
+      icon_x = winrect->x + (winrect->width - icon_w) / 2;
+      icon_y = winrect->y + (winrect->height - icon_h) / 2;
+
+      cairo_save (cr);
+      gdk_cairo_set_source_pixbuf (cr, icon, icon_x, icon_y);
+      cairo_rectangle (cr, icon_x, icon_y, icon_w, icon_h);
+      cairo_clip (cr);
+      cairo_paint_with_alpha (cr, translucency);
+      cairo_restore (cr);
+    }
+
+  fg = colors->fg;
+  fg.alpha = translucency;
+  gdk_cairo_set_source_rgba (cr, &fg);
+  cairo_set_line_width (cr, 1.0);
+  cairo_rectangle (cr,
+                   winrect->x + 0.5, winrect->y + 0.5,
+                   MAX (0, winrect->width - 1), MAX (0, winrect->height - 1));
+  cairo_stroke (cr);
+
+  cairo_restore (cr);
+}
+
+/* Returns the windows to draw in @workspace, from bottom to top, with their
+ * rectangles relative to the workspace. The list is only computed again when
+ * something changed in the workspace. */
+static GArray *
+wnck_pager_get_workspace_windows (WnckPager          *pager,
+                                  int                 workspace,
+                                  const GdkRectangle *workspace_rect)
+{
+  WnckPagerCachedWorkspace *cached;
+  WnckWorkspace *space;
+  GdkRectangle rect;
+  GList *windows;
+  GList *tmp;
+
+  cached = wnck_pager_get_cached_workspace (pager, workspace);
+
+  if (cached->windows == NULL)
+    cached->windows = g_array_new (FALSE, FALSE, sizeof (WnckPagerWindowRect));
+  else if (!cached->windows_dirty &&
+           cached->windows_width == workspace_rect->width &&
+           cached->windows_height == workspace_rect->height)
+    return cached->windows;
+
+  g_array_set_size (cached->windows, 0);
+
+  rect.x = 0;
+  rect.y = 0;
+  rect.width = workspace_rect->width;
+  rect.height = workspace_rect->height;
+
+  space = wnck_screen_get_workspace (pager->priv->screen, workspace);
+  windows = space ? get_windows_for_workspace_in_bottom_to_top (pager->priv->screen,
+                                                                space) : NULL;
 
   for (tmp = windows; tmp != NULL; tmp = tmp->next)
     {
-      WnckWindow *win = WNCK_WINDOW (tmp->data);
-      GdkRectangle winrect;
+      WnckPagerWindowRect winrect;
+
+      winrect.window = WNCK_WINDOW (tmp->data);
+      get_window_rect (winrect.window, &rect, &winrect.rect);
+
+      g_array_append_val (cached->windows, winrect);
+    }
+
+  g_list_free (windows);
+
+  cached->windows_width = rect.width;
+  cached->windows_height = rect.height;
+  cached->windows_dirty = FALSE;
+
+  return cached->windows;
+}
+
+static WnckWindow *
+window_at_point (WnckPager     *pager,
+                 WnckWorkspace *space,
+                 GdkRectangle  *space_rect,
+                 int            x,
+                 int            y)
+{
+  GArray *windows;
+  int i;
+
+  windows = wnck_pager_get_workspace_windows (pager,
+                                              wnck_workspace_get_number (space),
+                                              space_rect);
 
-      get_window_rect (win, space_rect, &winrect);
+  x -= space_rect->x;
+  y -= space_rect->y;
 
-      if (POINT_IN_RECT (x, y, winrect))
+  /* clicks on top windows first */
+  for (i = (int) windows->len - 1; i >= 0; i--)
+    {
+      WnckPagerWindowRect *winrect;
+
+      winrect = &g_array_index (windows, WnckPagerWindowRect, i);
+
+      if (POINT_IN_RECT (x, y, winrect->rect))
         {
           /* wnck_window_activate (win); */
-          window = win;
-          break;
+          return winrect->window;
         }
     }
 
-  g_list_free (windows);
+  return NULL;
+}
+
+/* Returns the workspace in the grid at the given point, without taking the
+ * frame into account */
+static int
+grid_workspace_at_point (WnckPager *pager,
+                         int        x,
+                         int        y)
+{
+  int col, row;
+  int n_spaces;
+  int spaces_per_row;
+  int space;
+
+  if (!pager->priv->workspace_rects_valid ||
+      pager->priv->workspace_rects->len != (guint) wnck_screen_get_workspace_count (pager->priv->screen))
+    wnck_pager_update_workspace_rects (pager);
+
+  n_spaces = pager->priv->workspace_rects->len;
+  if (n_spaces == 0)
+    return -1;
+
+  /* the line separating two workspaces belongs to the left/top one, and the
+   * frame to the workspaces on the edge */
+  col = (x - pager->priv->grid_x) / MAX (pager->priv->cell_width + 1, 1);
+  row = (y - pager->priv->grid_y) / MAX (pager->priv->cell_height + 1, 1);
+  col = CLAMP (col, 0, pager->priv->grid_columns - 1);
+  row = CLAMP (row, 0, pager->priv->grid_rows - 1);
+
+  if (gtk_widget_get_direction (GTK_WIDGET (pager)) == GTK_TEXT_DIR_RTL)
+    col = pager->priv->grid_columns - col - 1;
+
+  spaces_per_row = (n_spaces + pager->priv->n_rows - 1) / pager->priv->n_rows;
+
+  if (pager->priv->orientation == GTK_ORIENTATION_VERTICAL)
+    space = col * spaces_per_row + row;
+  else
+    space = row * spaces_per_row + col;
 
-  return window;
+  return space < n_spaces ? space : -1;
 }
 
 static int
@@ -1130,112 +2172,94 @@ workspace_at_point (WnckPager *pager,
 {
   GtkWidget *widget;
   int i;
-  int n_spaces;
   GtkAllocation allocation;
   int focus_width;
   GtkBorder padding;
+  GdkRectangle rect;
 
   widget = GTK_WIDGET (pager);
 
   gtk_widget_get_allocation (widget, &allocation);
 
-  gtk_widget_style_get (GTK_WIDGET (pager),
-			"focus-line-width", &focus_width,
-			NULL);
-  _wnck_pager_get_padding (pager, &padding);
+  wnck_pager_get_style_metrics (pager, &focus_width, &padding);
 
   padding.left += focus_width;
   padding.right += focus_width;
   padding.top += focus_width;
   padding.bottom += focus_width;
 
-  n_spaces = wnck_screen_get_workspace_count (pager->priv->screen);
-
-  i = 0;
-  while (i < n_spaces)
+  if (pager->priv->show_all_workspaces)
+    i = grid_workspace_at_point (pager, x, y);
+  else
     {
-      GdkRectangle rect;
+      WnckWorkspace *active_space;
 
-      get_workspace_rect (pager, i, &rect);
+      active_space = wnck_screen_get_active_workspace (pager->priv->screen);
+      i = active_space ? wnck_workspace_get_number (active_space) : -1;
+    }
 
-      /* If workspace is on the edge, pretend points on the frame belong to the
-       * workspace.
-       * Else, pretend the right/bottom line separating two workspaces belong
-       * to the workspace.
-       */
+  if (i < 0)
+    return -1;
 
-      if (rect.x == padding.left)
-        {
-          rect.x = 0;
-          rect.width += padding.left;
-        }
-      if (rect.y == padding.top)
-        {
-          rect.y = 0;
-          rect.height += padding.top;
-        }
-      if (rect.y + rect.height == allocation.height - padding.bottom)
-        {
-          rect.height += padding.bottom;
-        }
-      else
-        {
-          rect.height += 1;
-        }
-      if (rect.x + rect.width == allocation.width - padding.right)
-        {
-          rect.width += padding.right;
-        }
-      else
-        {
-          rect.width += 1;
-        }
+  get_workspace_rect (pager, i, &rect);
 
-      if (POINT_IN_RECT (x, y, rect))
-        {
-	  double width_ratio, height_ratio;
-	  WnckWorkspace *space;
+  /* If workspace is on the edge, pretend points on the frame belong to the
+   * workspace.
+   * Else, pretend the right/bottom line separating two workspaces belong
+   * to the workspace.
+   */
+
+  if (rect.x == padding.left)
+    {
+      rect.x = 0;
+      rect.width += padding.left;
+    }
+  if (rect.y == padding.top)
+    {
+      rect.y = 0;
+      rect.height += padding.top;
+    }
+  if (rect.y + rect.height == allocation.height - padding.bottom)
+    {
+      rect.height += padding.bottom;
+    }
+  else
+    {
+      rect.height += 1;
+    }
+  if (rect.x + rect.width == allocation.width - padding.right)
+    {
+      rect.width += padding.right;
+    }
+  else
+    {
+      rect.width += 1;
+    }
 
-	  space = wnck_screen_get_workspace (pager->priv->screen, i);
-          g_assert (space != NULL);
+  if (POINT_IN_RECT (x, y, rect))
+    {
+      double width_ratio, height_ratio;
+      WnckWorkspace *space;
 
-          /* Scale x, y mouse coords to corresponding screenwide viewport coords */
+      space = wnck_screen_get_workspace (pager->priv->screen, i);
+      g_assert (space != NULL);
 
-          width_ratio = (double) wnck_workspace_get_width (space) / (double) rect.width;
-          height_ratio = (double) wnck_workspace_get_height (space) / (double) rect.height;
+      /* Scale x, y mouse coords to corresponding screenwide viewport coords */
 
-          if (viewport_x)
-            *viewport_x = width_ratio * (x - rect.x);
-          if (viewport_y)
-            *viewport_y = height_ratio * (y - rect.y);
+      width_ratio = (double) wnck_workspace_get_width (space) / (double) rect.width;
+      height_ratio = (double) wnck_workspace_get_height (space) / (double) rect.height;
 
-	  return i;
-	}
+      if (viewport_x)
+        *viewport_x = width_ratio * (x - rect.x);
+      if (viewport_y)
+        *viewport_y = height_ratio * (y - rect.y);
 
-      ++i;
+      return i;
     }
 
   return -1;
 }
 
-static void
-get_dark_color_for_state (GtkStyleContext *context,
-			  GtkStateFlags    state,
-			  GdkRGBA         *dark)
-{
-  GdkRGBA           bg;
-  GtkSymbolicColor *c1, *c2;
-
-  gtk_style_context_get_background_color (context, state, &bg);
-
-  c1 = gtk_symbolic_color_new_literal (&bg);
-
-  c2 = gtk_symbolic_color_new_shade (c1, 0.7);
-  gtk_symbolic_color_resolve (c2, NULL, dark);
-  gtk_symbolic_color_unref (c2);
-  gtk_symbolic_color_unref (c1);
-}
-
 static void
 wnck_pager_draw_workspace (WnckPager    *pager,
                            cairo_t      *cr,
@@ -1243,14 +2267,14 @@ wnck_pager_draw_workspace (WnckPager    *pager,
 			   GdkRectangle *rect,
                            GdkPixbuf    *bg_pixbuf)
 {
-  GList *windows;
-  GList *tmp;
   gboolean is_current;
   WnckWorkspace *space;
   GtkWidget *widget;
   GtkStateFlags state;
   GtkStyleContext *context;
-  GdkRGBA color;
+  const WnckPagerColors *colors;
+  const WnckPagerColors *normal_colors;
+  const WnckPagerColors *selected_colors;
 
   space = wnck_screen_get_workspace (pager->priv->screen, workspace);
   if (!space)
@@ -1266,6 +2290,9 @@ wnck_pager_draw_workspace (WnckPager    *pager,
     state |= GTK_STATE_FLAG_PRELIGHT;
 
   context = gtk_widget_get_style_context (widget);
+  colors = wnck_pager_get_colors (pager, state);
+  normal_colors = wnck_pager_get_colors (pager, GTK_STATE_FLAG_NORMAL);
+  selected_colors = wnck_pager_get_colors (pager, GTK_STATE_FLAG_SELECTED);
 
   /* FIXME in names mode, should probably draw things like a button.
    */
@@ -1279,8 +2306,7 @@ wnck_pager_draw_workspace (WnckPager    *pager,
     {
       if (!wnck_workspace_is_virtual (space))
         {
-	  get_dark_color_for_state (context, state, &color);
-          gdk_cairo_set_source_rgba (cr, &color);
+          gdk_cairo_set_source_rgba (cr, &colors->workspace_bg);
           cairo_rectangle (cr, rect->x, rect->y, rect->width, rect->height);
           cairo_fill (cr);
         }
@@ -1348,11 +2374,10 @@ wnck_pager_draw_workspace (WnckPager    *pager,
                         vh = rect->height + rect->y - vy;
 
                       if (active_i == i && active_j == j)
-			get_dark_color_for_state (context, GTK_STATE_FLAG_SELECTED, &color);
+		        gdk_cairo_set_source_rgba (cr, &selected_colors->workspace_bg);
 		      else
-			get_dark_color_for_state (context, GTK_STATE_FLAG_NORMAL, &color);
+		        gdk_cairo_set_source_rgba (cr, &normal_colors->workspace_bg);
 
-		      gdk_cairo_set_source_rgba (cr, &color);
                       cairo_rectangle (cr, vx, vy, vw, vh);
                       cairo_fill (cr);
                     }
@@ -1364,8 +2389,7 @@ wnck_pager_draw_workspace (WnckPager    *pager,
               height_ratio = rect->height / (double) workspace_height;
 
               /* first draw non-active part of the viewport */
-	      get_dark_color_for_state (context, GTK_STATE_FLAG_NORMAL, &color);
-              gdk_cairo_set_source_rgba (cr, &color);
+              gdk_cairo_set_source_rgba (cr, &normal_colors->workspace_bg);
               cairo_rectangle (cr, rect->x, rect->y, rect->width, rect->height);
               cairo_fill (cr);
 
@@ -1379,8 +2403,7 @@ wnck_pager_draw_workspace (WnckPager    *pager,
                   vw = width_ratio * screen_width;
                   vh = height_ratio * screen_height;
 
-		  get_dark_color_for_state (context, GTK_STATE_FLAG_SELECTED, &color);
-                  gdk_cairo_set_source_rgba (cr, &color);
+                  gdk_cairo_set_source_rgba (cr, &selected_colors->workspace_bg);
                   cairo_rectangle (cr, vx, vy, vw, vh);
                   cairo_fill (cr);
                 }
@@ -1388,58 +2411,68 @@ wnck_pager_draw_workspace (WnckPager    *pager,
         }
     }
 
-  if (pager->priv->display_mode == WNCK_PAGER_DISPLAY_CONTENT)
+  if (pager->priv->display_mode != WNCK_PAGER_DISPLAY_NAME)
     {
-      windows = get_windows_for_workspace_in_bottom_to_top (pager->priv->screen,
-							    wnck_screen_get_workspace (pager->priv->screen,
-										       workspace));
+      GArray *windows;
+      guint i;
 
-      tmp = windows;
-      while (tmp != NULL)
-	{
-	  WnckWindow *win = tmp->data;
-	  GdkRectangle winrect;
+      windows = wnck_pager_get_workspace_windows (pager, workspace, rect);
 
-	  get_window_rect (win, rect, &winrect);
+      for (i = 0; i < windows->len; i++)
+	{
+	  WnckPagerWindowRect *winrect;
+	  WnckWindow *win;
+	  GdkRectangle drawrect;
+          cairo_surface_t *thumbnail;
+          GdkPixbuf *icon;
+
+	  winrect = &g_array_index (windows, WnckPagerWindowRect, i);
+	  win = winrect->window;
+
+	  drawrect = winrect->rect;
+	  drawrect.x += rect->x;
+	  drawrect.y += rect->y;
+
+          wnck_pager_set_drawn_window_rect (pager, win, workspace,
+                                            rect, &drawrect);
+
+          thumbnail = wnck_pager_get_thumbnail (pager, win,
+                                                drawrect.width - 2,
+                                                drawrect.height - 2);
+          icon = NULL;
+          if (thumbnail == NULL)
+            icon = wnck_pager_get_icon (pager, win,
+                                        drawrect.width - 2,
+                                        drawrect.height - 2);
 
 	  draw_window (cr,
-		       widget,
 		       win,
-		       &winrect,
-                       state,
-		       win == pager->priv->drag_window && pager->priv->dragging ? TRUE : FALSE);
-
-	  tmp = tmp->next;
+		       &drawrect,
+                       colors,
+		       win == pager->priv->drag_window && pager->priv->dragging ? TRUE : FALSE,
+                       thumbnail,
+                       icon);
 	}
-
-      g_list_free (windows);
     }
   else
     {
       /* Workspace name mode */
-      const char *workspace_name;
       PangoLayout *layout;
       int w, h;
 
-      workspace_name = wnck_workspace_get_name (wnck_screen_get_workspace (pager->priv->screen,
-									   workspace));
-      layout = gtk_widget_create_pango_layout  (widget,
-						workspace_name);
+      layout = wnck_pager_get_workspace_layout (pager, workspace);
 
       pango_layout_get_pixel_size (layout, &w, &h);
 
       if (is_current)
-	gtk_style_context_get_color (context, GTK_STATE_FLAG_SELECTED, &color);
+        gdk_cairo_set_source_rgba (cr, &selected_colors->fg);
       else
-	gtk_style_context_get_color (context, GTK_STATE_FLAG_NORMAL, &color);
-      gdk_cairo_set_source_rgba (cr, &color);
+        gdk_cairo_set_source_rgba (cr, &normal_colors->fg);
       cairo_move_to (cr,
                      rect->x + (rect->width - w) / 2,
                      rect->y + (rect->height - h) / 2);
 
       pango_cairo_show_layout (cr, layout);
-
-      g_object_unref (layout);
     }
 
   if (workspace == pager->priv->prelight && pager->priv->prelight_dnd)
@@ -1462,6 +2495,202 @@ wnck_pager_draw_workspace (WnckPager    *pager,
     }
 }
 
+static WnckPagerCachedWorkspace *
+wnck_pager_get_cached_workspace (WnckPager *pager,
+                                 int        workspace)
+{
+  if ((guint) workspace >= pager->priv->workspace_cache->len)
+    g_array_set_size (pager->priv->workspace_cache, workspace + 1);
+
+  return &g_array_index (pager->priv->workspace_cache,
+                         WnckPagerCachedWorkspace, workspace);
+}
+
+static PangoLayout *
+wnck_pager_get_workspace_layout (WnckPager *pager,
+                                 int        workspace)
+{
+  WnckPagerCachedWorkspace *cached;
+
+  cached = wnck_pager_get_cached_workspace (pager, workspace);
+
+  if (cached->name_layout == NULL)
+    {
+      WnckWorkspace *space;
+
+      space = wnck_screen_get_workspace (pager->priv->screen, workspace);
+      cached->name_layout =
+        gtk_widget_create_pango_layout (GTK_WIDGET (pager),
+                                        space ? wnck_workspace_get_name (space) : NULL);
+    }
+
+  return cached->name_layout;
+}
+
+static void
+wnck_pager_clear_workspace_layout (WnckPager *pager,
+                                   int        workspace)
+{
+  WnckPagerCachedWorkspace *cached;
+
+  if (workspace < 0 || (guint) workspace >= pager->priv->workspace_cache->len)
+    return;
+
+  cached = &g_array_index (pager->priv->workspace_cache,
+                           WnckPagerCachedWorkspace, workspace);
+  if (cached->name_layout)
+    {
+      g_object_unref (cached->name_layout);
+      cached->name_layout = NULL;
+    }
+}
+
+static void
+wnck_pager_clear_workspace_layouts (WnckPager *pager)
+{
+  guint i;
+
+  for (i = 0; i < pager->priv->workspace_cache->len; i++)
+    wnck_pager_clear_workspace_layout (pager, i);
+}
+
+/* Draws @workspace in the surface of @cached, creating the surface if
+ * needed; @rect is the position of the workspace in the pager. */
+static void
+wnck_pager_render_workspace (WnckPager                *pager,
+                             WnckPagerCachedWorkspace *cached,
+                             int                       workspace,
+                             GdkRectangle             *rect,
+                             GdkPixbuf                *bg_pixbuf)
+{
+  GdkRectangle  surface_rect;
+  cairo_t      *cr;
+  gboolean      full;
+
+  full = cached->dirty || cached->dirty_region == NULL;
+
+  if (cached->surface == NULL ||
+      cached->width != rect->width || cached->height != rect->height)
+    {
+      full = TRUE;
+
+      if (cached->surface)
+        cairo_surface_destroy (cached->surface);
+
+      cached->surface =
+        gdk_window_create_similar_surface (gtk_widget_get_window (GTK_WIDGET (pager)),
+                                           CAIRO_CONTENT_COLOR_ALPHA,
+                                           rect->width, rect->height);
+      cached->width = rect->width;
+      cached->height = rect->height;
+    }
+
+  surface_rect.x = 0;
+  surface_rect.y = 0;
+  surface_rect.width = rect->width;
+  surface_rect.height = rect->height;
+
+  cr = cairo_create (cached->surface);
+
+  /* only the content of some windows changed */
+  if (!full)
+    {
+      gdk_cairo_region (cr, cached->dirty_region);
+      cairo_clip (cr);
+    }
+
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+  wnck_pager_draw_workspace (pager, cr, workspace, &surface_rect, bg_pixbuf);
+
+  cairo_destroy (cr);
+
+  cached->dirty = FALSE;
+  if (cached->dirty_region)
+    {
+      cairo_region_destroy (cached->dirty_region);
+      cached->dirty_region = NULL;
+    }
+}
+
+static void
+wnck_pager_invalidate_workspace (WnckPager *pager,
+                                 gint       i)
+{
+  if (i < 0 || (guint) i >= pager->priv->workspace_cache->len)
+    return;
+
+  g_array_index (pager->priv->workspace_cache,
+                 WnckPagerCachedWorkspace, i).dirty = TRUE;
+  g_array_index (pager->priv->workspace_cache,
+                 WnckPagerCachedWorkspace, i).windows_dirty = TRUE;
+}
+
+/* Marks part of @i, relative to the workspace, to be drawn again without
+ * the windows having changed */
+static void
+wnck_pager_invalidate_workspace_rect (WnckPager          *pager,
+                                      gint                i,
+                                      const GdkRectangle *rect)
+{
+  WnckPagerCachedWorkspace *cached;
+
+  if (i < 0 || (guint) i >= pager->priv->workspace_cache->len)
+    return;
+
+  cached = &g_array_index (pager->priv->workspace_cache,
+                           WnckPagerCachedWorkspace, i);
+
+  if (cached->dirty)
+    return;
+
+  if (cached->dirty_region == NULL)
+    cached->dirty_region = cairo_region_create_rectangle ((cairo_rectangle_int_t *) rect);
+  else
+    cairo_region_union_rectangle (cached->dirty_region,
+                                  (cairo_rectangle_int_t *) rect);
+}
+
+static void
+wnck_pager_invalidate_all (WnckPager *pager)
+{
+  guint i;
+
+  for (i = 0; i < pager->priv->workspace_cache->len; i++)
+    {
+      g_array_index (pager->priv->workspace_cache,
+                     WnckPagerCachedWorkspace, i).dirty = TRUE;
+      g_array_index (pager->priv->workspace_cache,
+                     WnckPagerCachedWorkspace, i).windows_dirty = TRUE;
+    }
+}
+
+static void
+wnck_pager_clear_workspace_cache (WnckPager *pager)
+{
+  guint i;
+
+  for (i = 0; i < pager->priv->workspace_cache->len; i++)
+    {
+      WnckPagerCachedWorkspace *cached;
+
+      cached = &g_array_index (pager->priv->workspace_cache,
+                               WnckPagerCachedWorkspace, i);
+      if (cached->surface)
+        cairo_surface_destroy (cached->surface);
+      if (cached->dirty_region)
+        cairo_region_destroy (cached->dirty_region);
+      if (cached->windows)
+        g_array_free (cached->windows, TRUE);
+      if (cached->name_layout)
+        g_object_unref (cached->name_layout);
+    }
+
+  g_array_set_size (pager->priv->workspace_cache, 0);
+}
+
 static gboolean
 wnck_pager_draw (GtkWidget *widget,
                  cairo_t   *cr)
@@ -1485,9 +2714,7 @@ wnck_pager_draw (GtkWidget *widget,
 
   state = gtk_widget_get_state_flags (widget);
   context = gtk_widget_get_style_context (widget);
-  gtk_widget_style_get (widget,
-			"focus-line-width", &focus_width,
-			NULL);
+  wnck_pager_get_style_metrics (pager, &focus_width, NULL);
   gtk_style_context_save (context);
   gtk_style_context_set_state (context, state);
 
@@ -1514,30 +2741,52 @@ wnck_pager_draw (GtkWidget *widget,
 
   gtk_style_context_restore (context);
 
+  pager->priv->thumbnails_frame++;
+
   i = 0;
   while (i < n_spaces)
     {
       GdkRectangle rect;
+      WnckPagerCachedWorkspace *cached;
 
       if (pager->priv->show_all_workspaces ||
 	  (active_space && i == wnck_workspace_get_number (active_space)))
 	{
 	  get_workspace_rect (pager, i, &rect);
 
-          /* We only want to do this once, even if w/h change,
-           * for efficiency. width/height will only change by
-           * one pixel at most.
-           */
-          if (first &&
-              pager->priv->display_mode == WNCK_PAGER_DISPLAY_CONTENT)
+          if (rect.width <= 0 || rect.height <= 0)
             {
-              bg_pixbuf = wnck_pager_get_background (pager,
-                                                     rect.width,
-                                                     rect.height);
-              first = FALSE;
+              ++i;
+              continue;
             }
 
-	  wnck_pager_draw_workspace (pager, cr, i, &rect, bg_pixbuf);
+          cached = wnck_pager_get_cached_workspace (pager, i);
+
+          if (cached->dirty || cached->dirty_region != NULL ||
+              cached->surface == NULL ||
+              cached->width != rect.width || cached->height != rect.height)
+            {
+              /* We only want to do this once, even if w/h change,
+               * for efficiency. width/height will only change by
+               * one pixel at most.
+               */
+              if (first &&
+                  pager->priv->display_mode != WNCK_PAGER_DISPLAY_NAME)
+                {
+                  bg_pixbuf = wnck_pager_get_background (pager,
+                                                         rect.width,
+                                                         rect.height);
+                  first = FALSE;
+                }
+
+              wnck_pager_render_workspace (pager, cached, i, &rect, bg_pixbuf);
+            }
+
+          cairo_save (cr);
+          cairo_set_source_surface (cr, cached->surface, rect.x, rect.y);
+          cairo_rectangle (cr, rect.x, rect.y, rect.width, rect.height);
+          cairo_fill (cr);
+          cairo_restore (cr);
 	}
 
       ++i;
@@ -1614,23 +2863,110 @@ wnck_pager_queue_draw_workspace (WnckPager *pager,
   if (i < 0)
     return;
 
+  wnck_pager_invalidate_workspace (pager, i);
+
   get_workspace_rect (pager, i, &rect);
   gtk_widget_queue_draw_area (GTK_WIDGET (pager),
                               rect.x, rect.y,
 			      rect.width, rect.height);
 }
 
+static void
+wnck_pager_queue_draw_rect (WnckPager          *pager,
+                            const GdkRectangle *rect)
+{
+  if (rect->width <= 0 || rect->height <= 0)
+    return;
+
+  gtk_widget_queue_draw_area (GTK_WIDGET (pager),
+                              rect->x, rect->y,
+                              rect->width, rect->height);
+}
+
+/* Only queues a redraw of the areas where the window was last drawn and where
+ * it should be drawn now, which can be in two different workspaces */
 static void
 wnck_pager_queue_draw_window (WnckPager  *pager,
                               WnckWindow *window)
 {
-  gint workspace;
+  WnckPagerDrawnWindow *drawn;
+  GdkRectangle          workspace_rect;
+  GdkRectangle          old_rect;
+  GdkRectangle          new_rect;
+  gint                  workspace;
+
+  /* windows are not drawn in this mode */
+  if (pager->priv->display_mode == WNCK_PAGER_DISPLAY_NAME)
+    return;
+
+  old_rect.width = old_rect.height = 0;
+  new_rect.width = new_rect.height = 0;
+
+  drawn = g_hash_table_lookup (pager->priv->drawn_windows, window);
+  if (drawn)
+    {
+      wnck_pager_invalidate_workspace (pager, drawn->workspace);
+
+      get_workspace_rect (pager, drawn->workspace, &workspace_rect);
+      old_rect = drawn->rect;
+      old_rect.x += workspace_rect.x;
+      old_rect.y += workspace_rect.y;
+    }
 
   workspace = wnck_pager_window_get_workspace (window, TRUE);
-  if (workspace == -1)
-    return;
+  if (workspace != -1)
+    {
+      wnck_pager_invalidate_workspace (pager, workspace);
+
+      get_workspace_rect (pager, workspace, &workspace_rect);
+      get_window_rect (window, &workspace_rect, &new_rect);
+    }
+
+  if (drawn && workspace == drawn->workspace &&
+      new_rect.width > 0 && new_rect.height > 0 &&
+      old_rect.width > 0 && old_rect.height > 0)
+    {
+      gdk_rectangle_union (&old_rect, &new_rect, &new_rect);
+      wnck_pager_queue_draw_rect (pager, &new_rect);
+    }
+  else
+    {
+      wnck_pager_queue_draw_rect (pager, &old_rect);
+      wnck_pager_queue_draw_rect (pager, &new_rect);
+    }
+}
+
+/* Only queues a redraw of the area where the window is drawn, when its
+ * content changed but not its position */
+static void
+wnck_pager_queue_draw_window_content (WnckPager  *pager,
+                                      WnckWindow *window)
+{
+  WnckPagerDrawnWindow *drawn;
+  GdkRectangle          workspace_rect;
+  GdkRectangle          rect;
+
+  drawn = g_hash_table_lookup (pager->priv->drawn_windows, window);
+  if (drawn == NULL)
+    {
+      wnck_pager_queue_draw_window (pager, window);
+      return;
+    }
 
-  wnck_pager_queue_draw_workspace (pager, workspace);
+  wnck_pager_invalidate_workspace_rect (pager, drawn->workspace, &drawn->rect);
+
+  get_workspace_rect (pager, drawn->workspace, &workspace_rect);
+  rect = drawn->rect;
+  rect.x += workspace_rect.x;
+  rect.y += workspace_rect.y;
+  wnck_pager_queue_draw_rect (pager, &rect);
+}
+
+static void
+wnck_pager_queue_draw_all (WnckPager *pager)
+{
+  wnck_pager_invalidate_all (pager);
+  gtk_widget_queue_draw (GTK_WIDGET (pager));
 }
 
 static void
@@ -1844,6 +3180,7 @@ wnck_update_drag_icon (WnckWindow     *window,
   gint org_w, org_h, dnd_w, dnd_h;
   WnckWorkspace *workspace;
   GdkRectangle rect;
+  WnckPagerColors colors;
   cairo_surface_t *surface;
   GtkWidget *widget;
   cairo_t *cr;
@@ -1878,9 +3215,12 @@ wnck_update_drag_icon (WnckWindow     *window,
   surface = gdk_window_create_similar_surface (gtk_widget_get_window (widget),
                                                CAIRO_CONTENT_COLOR,
                                                rect.width, rect.height);
+  get_colors_for_state (gtk_widget_get_style_context (widget),
+                        GTK_STATE_FLAG_NORMAL, &colors);
+
   cr = cairo_create (surface);
-  draw_window (cr, widget, window,
-	       &rect, GTK_STATE_FLAG_NORMAL, FALSE);
+  draw_window (cr, window, &rect, &colors, FALSE, NULL,
+               get_unscaled_icon (window, rect.width - 2, rect.height - 2));
   cairo_destroy (cr);
   cairo_surface_set_device_offset (surface, 2, 2);
 
@@ -1995,6 +3335,8 @@ wnck_pager_motion (GtkWidget        *widget,
 				1, (GdkEvent *)event);
       pager->priv->dragging = TRUE;
       pager->priv->prelight_dnd = TRUE;
+      /* the dragged window is drawn translucent */
+      wnck_pager_queue_draw_window (pager, pager->priv->drag_window);
       _wnck_window_set_as_drag_icon (pager->priv->drag_window,
 				     context,
 				     GTK_WIDGET (pager));
@@ -2326,6 +3668,7 @@ wnck_pager_set_orientation (WnckPager     *pager,
 
   if (wnck_pager_set_layout_hint (pager))
     {
+      pager->priv->workspace_rects_valid = FALSE;
       gtk_widget_queue_resize (GTK_WIDGET (pager));
       return TRUE;
     }
@@ -2374,6 +3717,7 @@ wnck_pager_set_n_rows (WnckPager *pager,
 
   if (wnck_pager_set_layout_hint (pager))
     {
+      pager->priv->workspace_rects_valid = FALSE;
       gtk_widget_queue_resize (GTK_WIDGET (pager));
       return TRUE;
     }
@@ -2403,7 +3747,31 @@ wnck_pager_set_display_mode (WnckPager            *pager,
 
   g_object_set (pager, "has-tooltip", mode != WNCK_PAGER_DISPLAY_NAME, NULL);
 
+  if (pager->priv->display_mode == WNCK_PAGER_DISPLAY_THUMBNAILS)
+    wnck_pager_clear_thumbnails (pager);
+
+  if (pager->priv->screen &&
+      (pager->priv->display_mode == WNCK_PAGER_DISPLAY_NAME ||
+       mode == WNCK_PAGER_DISPLAY_NAME))
+    {
+      GList *tmp;
+
+      /* the windows signals we need depend on the mode */
+      for (tmp = wnck_screen_get_windows (pager->priv->screen); tmp; tmp = tmp->next)
+        wnck_pager_disconnect_window (pager, WNCK_WINDOW (tmp->data));
+
+      /* we did not follow the windows in names mode */
+      g_hash_table_remove_all (pager->priv->drawn_windows);
+      g_hash_table_remove_all (pager->priv->icons);
+
+      pager->priv->display_mode = mode;
+
+      for (tmp = wnck_screen_get_windows (pager->priv->screen); tmp; tmp = tmp->next)
+        wnck_pager_connect_window (pager, WNCK_WINDOW (tmp->data));
+    }
+
   pager->priv->display_mode = mode;
+  wnck_pager_invalidate_all (pager);
   gtk_widget_queue_resize (GTK_WIDGET (pager));
 }
 
@@ -2427,6 +3795,7 @@ wnck_pager_set_show_all (WnckPager *pager,
     return;
 
   pager->priv->show_all_workspaces = show_all_workspaces;
+  pager->priv->workspace_rects_valid = FALSE;
   gtk_widget_queue_resize (GTK_WIDGET (pager));
 }
 
@@ -2451,6 +3820,9 @@ wnck_pager_set_shadow_type (WnckPager *   pager,
     return;
 
   pager->priv->shadow_type = shadow_type;
+  /* the padding is only used with a shadow */
+  pager->priv->style_valid = FALSE;
+  pager->priv->workspace_rects_valid = FALSE;
   gtk_widget_queue_resize (GTK_WIDGET (pager));
 }
 
@@ -2460,7 +3832,11 @@ active_window_changed_callback    (WnckScreen      *screen,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
-  gtk_widget_queue_draw (GTK_WIDGET (pager));
+
+  if (previous_window)
+    wnck_pager_queue_draw_window (pager, previous_window);
+  if (wnck_screen_get_active_window (screen))
+    wnck_pager_queue_draw_window (pager, wnck_screen_get_active_window (screen));
 }
 
 static void
@@ -2469,7 +3845,7 @@ active_workspace_changed_callback (WnckScreen      *screen,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
-  gtk_widget_queue_draw (GTK_WIDGET (pager));
+  wnck_pager_queue_draw_all (pager);
 }
 
 static void
@@ -2477,7 +3853,7 @@ window_stacking_changed_callback  (WnckScreen      *screen,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
-  gtk_widget_queue_draw (GTK_WIDGET (pager));
+  wnck_pager_queue_draw_all (pager);
 }
 
 static void
@@ -2502,6 +3878,9 @@ window_closed_callback            (WnckScreen      *screen,
     wnck_pager_clear_drag (pager);
 
   wnck_pager_queue_draw_window (pager, window);
+  g_hash_table_remove (pager->priv->drawn_windows, window);
+  g_hash_table_remove (pager->priv->icons, window);
+  wnck_pager_remove_thumbnail (pager, window);
 }
 
 static void
@@ -2510,6 +3889,8 @@ workspace_created_callback        (WnckScreen      *screen,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
+  pager->priv->workspace_rects_valid = FALSE;
+  wnck_pager_clear_workspace_layout (pager, wnck_workspace_get_number (space));
   g_signal_connect (space, "name_changed",
                     G_CALLBACK (workspace_name_changed_callback), pager);
   gtk_widget_queue_resize (GTK_WIDGET (pager));
@@ -2521,6 +3902,8 @@ workspace_destroyed_callback      (WnckScreen      *screen,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
+  pager->priv->workspace_rects_valid = FALSE;
+  wnck_pager_clear_workspace_layout (pager, wnck_workspace_get_number (space));
   g_signal_handlers_disconnect_by_func (space, G_CALLBACK (workspace_name_changed_callback), pager);
   gtk_widget_queue_resize (GTK_WIDGET (pager));
 }
@@ -2541,14 +3924,6 @@ application_closed_callback       (WnckScreen      *screen,
   /*   WnckPager *pager = WNCK_PAGER (data); */
 }
 
-static void
-window_name_changed_callback      (WnckWindow      *window,
-                                   gpointer         data)
-{
-  WnckPager *pager = WNCK_PAGER (data);
-  wnck_pager_queue_draw_window (pager, window);
-}
-
 static void
 window_state_changed_callback     (WnckWindow      *window,
                                    WnckWindowState  changed,
@@ -2573,7 +3948,7 @@ window_workspace_changed_callback (WnckWindow      *window,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
-  gtk_widget_queue_draw (GTK_WIDGET (pager));
+  wnck_pager_queue_draw_window (pager, window);
 }
 
 static void
@@ -2581,6 +3956,8 @@ window_icon_changed_callback      (WnckWindow      *window,
                                    gpointer         data)
 {
   WnckPager *pager = WNCK_PAGER (data);
+
+  g_hash_table_remove (pager->priv->icons, window);
   wnck_pager_queue_draw_window (pager, window);
 }
 
@@ -2598,20 +3975,24 @@ background_changed_callback (WnckWindow *window,
                              gpointer    data)
 {
   WnckPager *pager = WNCK_PAGER (data);
-
-  if (pager->priv->bg_cache)
-    {
-      g_object_unref (G_OBJECT (pager->priv->bg_cache));
-      pager->priv->bg_cache = NULL;
-    }
-
-  gtk_widget_queue_draw (GTK_WIDGET (pager));
+  WnckPagerBackground *background;
+
+  /* The background is shared by all pagers on the screen: this is only loaded
+   * once, and all pagers get redrawn when it's ready. Until then, we keep
+   * showing the old one. */
+  background = wnck_pager_background_get (pager->priv->screen);
+  background->valid = FALSE;
+  wnck_pager_background_queue_load (background);
 }
 
 static void
 workspace_name_changed_callback (WnckWorkspace *space,
                                  gpointer       data)
 {
+  wnck_pager_clear_workspace_layout (WNCK_PAGER (data),
+                                     wnck_workspace_get_number (space));
+  wnck_pager_invalidate_workspace (WNCK_PAGER (data),
+                                   wnck_workspace_get_number (space));
   gtk_widget_queue_resize (GTK_WIDGET (data));
 }
 
@@ -2619,6 +4000,7 @@ static void
 viewports_changed_callback (WnckWorkspace *space,
                             gpointer       data)
 {
+  wnck_pager_invalidate_all (WNCK_PAGER (data));
   gtk_widget_queue_resize (GTK_WIDGET (data));
 }
 
@@ -2629,6 +4011,7 @@ wnck_pager_connect_screen (WnckPager *pager)
   guint *c;
   GList *tmp;
   WnckScreen *screen;
+  WnckPagerBackground *background;
 
   g_return_if_fail (pager->priv->screen != NULL);
 
@@ -2699,6 +4082,9 @@ wnck_pager_connect_screen (WnckPager *pager)
 
   g_assert (i == N_SCREEN_CONNECTIONS);
 
+  background = wnck_pager_background_get (screen);
+  background->pagers = g_slist_prepend (background->pagers, pager);
+
   /* connect to name_changed on each workspace */
   for (i = 0; i < wnck_screen_get_workspace_count (pager->priv->screen); i++)
     {
@@ -2709,13 +4095,16 @@ wnck_pager_connect_screen (WnckPager *pager)
     }
 }
 
+/* Only the signals that can change what is drawn are connected: the names of
+ * the windows are never drawn, and nothing about the windows is drawn in
+ * WNCK_PAGER_DISPLAY_NAME mode. */
 static void
 wnck_pager_connect_window (WnckPager  *pager,
                            WnckWindow *window)
 {
-  g_signal_connect (G_OBJECT (window), "name_changed",
-                    G_CALLBACK (window_name_changed_callback),
-                    pager);
+  if (pager->priv->display_mode == WNCK_PAGER_DISPLAY_NAME)
+    return;
+
   g_signal_connect (G_OBJECT (window), "state_changed",
                     G_CALLBACK (window_state_changed_callback),
                     pager);
@@ -2735,6 +4124,7 @@ wnck_pager_disconnect_screen (WnckPager  *pager)
 {
   int i;
   GList *tmp;
+  WnckPagerBackground *background;
 
   if (pager->priv->screen == NULL)
     return;
@@ -2762,15 +4152,19 @@ wnck_pager_disconnect_screen (WnckPager  *pager)
     {
       wnck_pager_disconnect_window (pager, WNCK_WINDOW (tmp->data));
     }
+
+  g_hash_table_remove_all (pager->priv->drawn_windows);
+  g_hash_table_remove_all (pager->priv->icons);
+  wnck_pager_clear_workspace_layouts (pager);
+
+  background = wnck_pager_background_get (pager->priv->screen);
+  background->pagers = g_slist_remove (background->pagers, pager);
 }
 
 static void
 wnck_pager_disconnect_window (WnckPager  *pager,
                               WnckWindow *window)
 {
-  g_signal_handlers_disconnect_by_func (G_OBJECT (window),
-                                        G_CALLBACK (window_name_changed_callback),
-                                        pager);
   g_signal_handlers_disconnect_by_func (G_OBJECT (window),
                                         G_CALLBACK (window_state_changed_callback),
                                         pager);
@@ -2797,13 +4191,96 @@ wnck_pager_clear_drag (WnckPager *pager)
   pager->priv->drag_start_y = -1;
 }
 
+static void
+wnck_pager_background_free (gpointer data)
+{
+  WnckPagerBackground *background = data;
+
+  if (background->idle != 0)
+    g_source_remove (background->idle);
+
+  if (background->pixbuf)
+    g_object_unref (background->pixbuf);
+
+  g_slist_free (background->pagers);
+
+  g_slice_free (WnckPagerBackground, background);
+}
+
+static WnckPagerBackground *
+wnck_pager_background_get (WnckScreen *screen)
+{
+  WnckPagerBackground *background;
+
+  background = g_object_get_data (G_OBJECT (screen), "wnck-pager-background");
+
+  if (background == NULL)
+    {
+      background = g_slice_new0 (WnckPagerBackground);
+      background->screen = screen;
+
+      g_object_set_data_full (G_OBJECT (screen), "wnck-pager-background",
+                              background, wnck_pager_background_free);
+    }
+
+  return background;
+}
+
+static gboolean
+wnck_pager_background_load (gpointer data)
+{
+  WnckPagerBackground *background = data;
+  GdkPixbuf *pixbuf;
+  Pixmap p;
+  GSList *l;
+
+  background->idle = 0;
+
+  pixbuf = NULL;
+  p = wnck_screen_get_background_pixmap (background->screen);
+
+  if (p != None)
+    pixbuf = _wnck_gdk_pixbuf_get_scaled_from_pixmap (WNCK_SCREEN_XSCREEN (background->screen),
+                                                      p,
+                                                      background->width,
+                                                      background->height);
+
+  if (background->pixbuf)
+    g_object_unref (background->pixbuf);
+  background->pixbuf = pixbuf;
+  background->valid = TRUE;
+
+  for (l = background->pagers; l != NULL; l = l->next)
+    {
+      WnckPager *pager = WNCK_PAGER (l->data);
+
+      if (pager->priv->bg_cache)
+        {
+          g_object_unref (G_OBJECT (pager->priv->bg_cache));
+          pager->priv->bg_cache = NULL;
+        }
+
+      wnck_pager_queue_draw_all (pager);
+    }
+
+  return FALSE;
+}
+
+static void
+wnck_pager_background_queue_load (WnckPagerBackground *background)
+{
+  if (background->idle == 0)
+    background->idle = g_idle_add_full (G_PRIORITY_LOW,
+                                        wnck_pager_background_load,
+                                        background, NULL);
+}
+
 static GdkPixbuf*
 wnck_pager_get_background (WnckPager *pager,
                            int        width,
                            int        height)
 {
-  Pixmap p;
-  GdkPixbuf *pix = NULL;
+  WnckPagerBackground *background;
 
   /* We have to be careful not to keep alternating between
    * width/height values, otherwise this would get really slow.
@@ -2822,33 +4299,31 @@ wnck_pager_get_background (WnckPager *pager,
   if (pager->priv->screen == NULL)
     return NULL;
 
-  /* FIXME this just globally disables the thumbnailing feature */
-  return NULL;
-
-#define MIN_BG_SIZE 10
-
   if (width < MIN_BG_SIZE || height < MIN_BG_SIZE)
     return NULL;
 
-  p = wnck_screen_get_background_pixmap (pager->priv->screen);
+  /* Getting the background from the X server is slow, so this is never done
+   * while drawing: we use what is available, and get redrawn when the
+   * background is loaded. */
+  background = wnck_pager_background_get (pager->priv->screen);
 
-  if (p != None)
+  if (width > background->width || height > background->height)
     {
-      Screen *xscreen;
-
-      xscreen = WNCK_SCREEN_XSCREEN (pager->priv->screen);
-      pix = _wnck_gdk_pixbuf_get_from_pixmap (xscreen, p);
+      background->width = MAX (background->width, width);
+      background->height = MAX (background->height, height);
+      background->valid = FALSE;
     }
 
-  if (pix)
-    {
-      pager->priv->bg_cache = gdk_pixbuf_scale_simple (pix,
-                                                       width,
-                                                       height,
-                                                       GDK_INTERP_BILINEAR);
+  if (!background->valid)
+    wnck_pager_background_queue_load (background);
 
-      g_object_unref (G_OBJECT (pix));
-    }
+  if (background->pixbuf == NULL)
+    return NULL;
+
+  pager->priv->bg_cache = gdk_pixbuf_scale_simple (background->pixbuf,
+                                                   width,
+                                                   height,
+                                                   GDK_INTERP_BILINEAR);
 
   return pager->priv->bg_cache;
 }
@@ -74,12 +74,17 @@ struct _WnckPagerClass
  * workspaces.
  * @WNCK_PAGER_DISPLAY_CONTENT: the #WnckPager will display a representation
  * for each window in the workspaces.
+ * @WNCK_PAGER_DISPLAY_THUMBNAILS: the #WnckPager will display a live
+ * thumbnail of each window in the workspaces. This requires the Composite and
+ * Damage extensions; without them, this is the same as
+ * @WNCK_PAGER_DISPLAY_CONTENT. Since 3.4.
  *
  * Mode defining what a #WnckPager will display.
  */
 typedef enum {
   WNCK_PAGER_DISPLAY_NAME,
-  WNCK_PAGER_DISPLAY_CONTENT
+  WNCK_PAGER_DISPLAY_CONTENT,
+  WNCK_PAGER_DISPLAY_THUMBNAILS
 } WnckPagerDisplayMode;
 
 GType wnck_pager_get_type (void) G_GNUC_CONST;
@@ -56,6 +56,9 @@ WnckWindow* _wnck_window_create  (Window      xwindow,
                                   gint        sort_order);
 void        _wnck_window_destroy (WnckWindow *window);
 
+void        _wnck_window_interest_added (WnckWindow         *window,
+                                         WnckScreenInterest  added);
+
 char*       _wnck_window_get_name_for_display (WnckWindow *window,
                                                gboolean    use_icon_name,
                                                gboolean    use_state_decorations);
@@ -109,6 +112,14 @@ void _wnck_screen_change_workspace_name (WnckScreen *screen,
 
 void _wnck_screen_shutdown_all          (void);
 
+gboolean _wnck_screen_get_workspace_layout_position    (WnckScreen *screen,
+                                                        int         space_index,
+                                                        int        *row,
+                                                        int        *column);
+int      _wnck_screen_get_workspace_at_layout_position (WnckScreen *screen,
+                                                        int         row,
+                                                        int         column);
+
 gboolean _wnck_workspace_set_geometry (WnckWorkspace *space, int w, int h);
 gboolean _wnck_workspace_set_viewport (WnckWorkspace *space, int x, int y);
 
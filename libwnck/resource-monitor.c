@@ -0,0 +1,623 @@
+/* resource monitor object */
+/* vim: set sw=2 et: */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <config.h>
+
+#include <string.h>
+#include "resource-monitor.h"
+#include "application.h"
+#include "window.h"
+#include "private.h"
+#include "wnck-marshal.h"
+
+/**
+ * SECTION:resource-monitor
+ * @short_description: an object following the X resource usage of
+ * applications over time.
+ * @see_also: wnck_read_resource_usage_all()
+ * @stability: Unstable
+ *
+ * The #WnckResourceMonitor samples the X resource usage of all the
+ * #WnckApplication with windows on a #WnckScreen at a regular interval, and
+ * keeps the last samples of each #WnckApplication. This makes it possible to
+ * notice an application that keeps allocating resources in the X server
+ * without freeing them, by looking at the #WnckResourceUsageDelta between the
+ * oldest and the newest samples.
+ *
+ * The resources used by an application are the resources of the X clients
+ * owning its windows. With version 1.2 of the XRes extension, taking a sample
+ * costs three requests to the X server whatever the number of X clients; with
+ * older versions, it costs two requests per X client. The memory used by the
+ * monitor only depends on the number of applications and on the length of the
+ * history.
+ *
+ * To properly work, the #WnckResourceMonitor requires the XRes extension on
+ * the X server.
+ */
+
+/* Last samples of an application, in a ring buffer */
+typedef struct
+{
+  WnckResourceSample *samples;
+  guint               first; /* oldest sample */
+  guint               n_samples;
+} WnckResourceHistory;
+
+struct _WnckResourceMonitorPrivate
+{
+  WnckScreen *screen;
+
+  guint interval;
+  guint history_length;
+  guint timeout;
+
+  GHashTable *histories; /* WnckApplication -> WnckResourceHistory */
+
+  GArray *usages; /* WnckClientResourceUsage, reused for each sample */
+
+  gulong application_closed_id;
+};
+
+G_DEFINE_TYPE (WnckResourceMonitor, wnck_resource_monitor, G_TYPE_OBJECT);
+#define WNCK_RESOURCE_MONITOR_GET_PRIVATE(o) (G_TYPE_INSTANCE_GET_PRIVATE ((o), WNCK_TYPE_RESOURCE_MONITOR, WnckResourceMonitorPrivate))
+
+enum {
+  USAGE_CHANGED,
+  LAST_SIGNAL
+};
+
+static void wnck_resource_monitor_init        (WnckResourceMonitor      *monitor);
+static void wnck_resource_monitor_class_init  (WnckResourceMonitorClass *klass);
+static void wnck_resource_monitor_finalize    (GObject                  *object);
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+static void
+wnck_resource_history_free (gpointer data)
+{
+  WnckResourceHistory *history = data;
+
+  g_free (history->samples);
+  g_slice_free (WnckResourceHistory, history);
+}
+
+static WnckResourceSample *
+wnck_resource_history_get_sample (WnckResourceMonitor *monitor,
+                                  WnckResourceHistory *history,
+                                  guint                i)
+{
+  return &history->samples[(history->first + i) % monitor->priv->history_length];
+}
+
+static void
+wnck_resource_monitor_init (WnckResourceMonitor *monitor)
+{
+  monitor->priv = WNCK_RESOURCE_MONITOR_GET_PRIVATE (monitor);
+
+  monitor->priv->screen = NULL;
+
+  monitor->priv->interval = 0;
+  monitor->priv->history_length = 1;
+  monitor->priv->timeout = 0;
+
+  monitor->priv->histories = g_hash_table_new_full (NULL, NULL, NULL,
+                                                    wnck_resource_history_free);
+
+  monitor->priv->usages = g_array_new (FALSE, FALSE,
+                                       sizeof (WnckClientResourceUsage));
+
+  monitor->priv->application_closed_id = 0;
+}
+
+static void
+wnck_resource_monitor_class_init (WnckResourceMonitorClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  g_type_class_add_private (klass, sizeof (WnckResourceMonitorPrivate));
+
+  object_class->finalize = wnck_resource_monitor_finalize;
+
+  /**
+   * WnckResourceMonitor::usage-changed:
+   * @monitor: the #WnckResourceMonitor which emitted the signal.
+   * @app: the #WnckApplication whose X resource usage changed.
+   * @delta: (type gpointer): the #WnckResourceUsageDelta between the previous
+   * sample and the new one.
+   *
+   * Emitted after a sample, for each #WnckApplication whose X resource usage
+   * changed since the previous sample.
+   *
+   * Since: 3.4
+   */
+  signals[USAGE_CHANGED] =
+    g_signal_new ("usage_changed",
+                  G_OBJECT_CLASS_TYPE (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (WnckResourceMonitorClass, usage_changed),
+                  NULL, NULL,
+                  _wnck_marshal_VOID__OBJECT_POINTER,
+                  G_TYPE_NONE, 2,
+                  WNCK_TYPE_APPLICATION, G_TYPE_POINTER);
+}
+
+static void
+wnck_resource_monitor_finalize (GObject *object)
+{
+  WnckResourceMonitor *monitor;
+
+  monitor = WNCK_RESOURCE_MONITOR (object);
+
+  if (monitor->priv->timeout != 0)
+    g_source_remove (monitor->priv->timeout);
+  monitor->priv->timeout = 0;
+
+  /* the screen is gone already after wnck_shutdown() */
+  if (monitor->priv->screen != NULL)
+    {
+      g_signal_handler_disconnect (monitor->priv->screen,
+                                   monitor->priv->application_closed_id);
+      g_object_remove_weak_pointer (G_OBJECT (monitor->priv->screen),
+                                    (gpointer *) &monitor->priv->screen);
+    }
+  monitor->priv->screen = NULL;
+  monitor->priv->application_closed_id = 0;
+
+  g_hash_table_destroy (monitor->priv->histories);
+  monitor->priv->histories = NULL;
+
+  g_array_free (monitor->priv->usages, TRUE);
+  monitor->priv->usages = NULL;
+
+  G_OBJECT_CLASS (wnck_resource_monitor_parent_class)->finalize (object);
+}
+
+static void
+application_closed_callback (WnckScreen      *screen,
+                             WnckApplication *app,
+                             gpointer         data)
+{
+  WnckResourceMonitor *monitor = WNCK_RESOURCE_MONITOR (data);
+
+  g_hash_table_remove (monitor->priv->histories, app);
+}
+
+static gboolean
+wnck_resource_monitor_timeout (gpointer data)
+{
+  wnck_resource_monitor_sample (WNCK_RESOURCE_MONITOR (data));
+
+  return TRUE;
+}
+
+/**
+ * wnck_resource_monitor_new:
+ * @screen: a #WnckScreen.
+ * @interval: the number of seconds between two samples, or 0 to only take
+ * samples with wnck_resource_monitor_sample().
+ * @history_length: the number of samples to keep for each #WnckApplication.
+ *
+ * Creates a new #WnckResourceMonitor following the X resource usage of the
+ * #WnckApplication with windows on @screen. The monitor does not keep
+ * @screen alive: once @screen is destroyed, for example by wnck_shutdown(),
+ * the monitor stops taking samples.
+ *
+ * Return value: a newly created #WnckResourceMonitor.
+ *
+ * Since: 3.4
+ */
+WnckResourceMonitor *
+wnck_resource_monitor_new (WnckScreen *screen,
+                           guint       interval,
+                           guint       history_length)
+{
+  WnckResourceMonitor *monitor;
+
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), NULL);
+
+  monitor = g_object_new (WNCK_TYPE_RESOURCE_MONITOR, NULL);
+
+  monitor->priv->screen = screen;
+  g_object_add_weak_pointer (G_OBJECT (screen),
+                             (gpointer *) &monitor->priv->screen);
+  monitor->priv->history_length = MAX (history_length, 1);
+
+  monitor->priv->application_closed_id =
+    g_signal_connect (screen, "application_closed",
+                      G_CALLBACK (application_closed_callback), monitor);
+
+  wnck_resource_monitor_set_interval (monitor, interval);
+
+  return monitor;
+}
+
+/**
+ * wnck_resource_monitor_set_interval:
+ * @monitor: a #WnckResourceMonitor.
+ * @interval: the number of seconds between two samples, or 0 to only take
+ * samples with wnck_resource_monitor_sample().
+ *
+ * Sets the interval between two samples taken by @monitor.
+ *
+ * Since: 3.4
+ */
+void
+wnck_resource_monitor_set_interval (WnckResourceMonitor *monitor,
+                                    guint                interval)
+{
+  g_return_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor));
+
+  if (monitor->priv->interval == interval)
+    return;
+
+  monitor->priv->interval = interval;
+
+  if (monitor->priv->timeout != 0)
+    g_source_remove (monitor->priv->timeout);
+  monitor->priv->timeout = 0;
+
+  if (interval > 0)
+    monitor->priv->timeout = g_timeout_add_seconds (interval,
+                                                    wnck_resource_monitor_timeout,
+                                                    monitor);
+}
+
+/**
+ * wnck_resource_monitor_get_interval:
+ * @monitor: a #WnckResourceMonitor.
+ *
+ * Gets the interval between two samples taken by @monitor.
+ *
+ * Return value: the number of seconds between two samples, or 0 if @monitor
+ * does not take samples by itself.
+ *
+ * Since: 3.4
+ */
+guint
+wnck_resource_monitor_get_interval (WnckResourceMonitor *monitor)
+{
+  g_return_val_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor), 0);
+
+  return monitor->priv->interval;
+}
+
+/**
+ * wnck_resource_monitor_get_history_length:
+ * @monitor: a #WnckResourceMonitor.
+ *
+ * Gets the maximum number of samples kept by @monitor for each
+ * #WnckApplication.
+ *
+ * Return value: the maximum number of samples kept for each #WnckApplication.
+ *
+ * Since: 3.4
+ */
+guint
+wnck_resource_monitor_get_history_length (WnckResourceMonitor *monitor)
+{
+  g_return_val_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor), 0);
+
+  return monitor->priv->history_length;
+}
+
+static int
+compare_client_usages (gconstpointer a,
+                       gconstpointer b)
+{
+  const WnckClientResourceUsage *usage_a = a;
+  const WnckClientResourceUsage *usage_b = b;
+
+  if (usage_a->xid < usage_b->xid)
+    return -1;
+  else if (usage_a->xid > usage_b->xid)
+    return 1;
+  else
+    return 0;
+}
+
+/* Returns the index of the X client owning @xid in the sorted @usages: the
+ * resources of a client start at its resource base. */
+static int
+find_client_for_xid (GArray *usages,
+                     gulong  xid)
+{
+  int low, high;
+
+  low = 0;
+  high = (int) usages->len - 1;
+
+  while (low <= high)
+    {
+      int middle = (low + high) / 2;
+
+      if (g_array_index (usages, WnckClientResourceUsage, middle).xid <= xid)
+        low = middle + 1;
+      else
+        high = middle - 1;
+    }
+
+  return high;
+}
+
+static void
+add_usage (WnckResourceUsage       *total,
+           const WnckResourceUsage *usage)
+{
+  total->total_bytes_estimate += usage->total_bytes_estimate;
+  total->pixmap_bytes += usage->pixmap_bytes;
+  total->n_pixmaps += usage->n_pixmaps;
+  total->n_windows += usage->n_windows;
+  total->n_gcs += usage->n_gcs;
+  total->n_pictures += usage->n_pictures;
+  total->n_glyphsets += usage->n_glyphsets;
+  total->n_fonts += usage->n_fonts;
+  total->n_colormap_entries += usage->n_colormap_entries;
+  total->n_passive_grabs += usage->n_passive_grabs;
+  total->n_cursors += usage->n_cursors;
+  total->n_other += usage->n_other;
+}
+
+static void
+compute_delta (const WnckResourceSample *old,
+               const WnckResourceSample *new,
+               WnckResourceUsageDelta   *delta)
+{
+  delta->period = new->time - old->time;
+
+#define DELTA(field) delta->field = new->usage.field - old->usage.field
+  DELTA (total_bytes_estimate);
+  DELTA (pixmap_bytes);
+  DELTA (n_pixmaps);
+  DELTA (n_windows);
+  DELTA (n_gcs);
+  DELTA (n_pictures);
+  DELTA (n_glyphsets);
+  DELTA (n_fonts);
+  DELTA (n_colormap_entries);
+  DELTA (n_passive_grabs);
+  DELTA (n_cursors);
+  DELTA (n_other);
+#undef DELTA
+}
+
+typedef struct
+{
+  WnckApplication        *app;
+  WnckResourceUsageDelta  delta;
+} WnckResourceChange;
+
+/**
+ * wnck_resource_monitor_sample:
+ * @monitor: a #WnckResourceMonitor.
+ *
+ * Takes a sample of the X resource usage of all #WnckApplication with windows
+ * on the #WnckScreen of @monitor now, and emits #WnckResourceMonitor::usage-changed
+ * for each #WnckApplication whose usage changed since the previous sample.
+ *
+ * Since: 3.4
+ */
+void
+wnck_resource_monitor_sample (WnckResourceMonitor *monitor)
+{
+  GdkDisplay *display;
+  GArray     *usages;
+  GHashTable *app_clients;
+  GHashTableIter iter;
+  gpointer    key, value;
+  GArray     *changes;
+  GList      *l;
+  gint64      now;
+  guint       i;
+
+  g_return_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor));
+
+  if (monitor->priv->screen == NULL)
+    return;
+
+  display = gdk_screen_get_display (_wnck_screen_get_gdk_screen (monitor->priv->screen));
+  usages = monitor->priv->usages;
+
+  wnck_read_resource_usage_all (display, usages);
+  if (usages->len == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+
+  g_array_sort (usages, compare_client_usages);
+
+  /* the X clients owning the windows of each application */
+  app_clients = g_hash_table_new_full (NULL, NULL,
+                                       NULL, (GDestroyNotify) g_slist_free);
+
+  for (l = wnck_screen_get_windows (monitor->priv->screen); l; l = l->next)
+    {
+      WnckWindow      *window = l->data;
+      WnckApplication *app;
+      GSList          *clients;
+      int              client;
+
+      app = wnck_window_get_application (window);
+      if (app == NULL)
+        continue;
+
+      client = find_client_for_xid (usages, wnck_window_get_xid (window));
+      if (client < 0)
+        continue;
+
+      clients = g_hash_table_lookup (app_clients, app);
+      if (g_slist_find (clients, GINT_TO_POINTER (client)))
+        continue;
+
+      g_hash_table_steal (app_clients, app);
+      g_hash_table_insert (app_clients, app,
+                           g_slist_prepend (clients, GINT_TO_POINTER (client)));
+    }
+
+  changes = g_array_new (FALSE, FALSE, sizeof (WnckResourceChange));
+
+  g_hash_table_iter_init (&iter, app_clients);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      WnckApplication     *app = key;
+      WnckResourceHistory *history;
+      WnckResourceSample   sample;
+      GSList              *c;
+
+      sample.time = now;
+      memset (&sample.usage, '\0', sizeof (sample.usage));
+
+      for (c = value; c; c = c->next)
+        add_usage (&sample.usage,
+                   &g_array_index (usages, WnckClientResourceUsage,
+                                   GPOINTER_TO_INT (c->data)).usage);
+
+      history = g_hash_table_lookup (monitor->priv->histories, app);
+      if (history == NULL)
+        {
+          history = g_slice_new0 (WnckResourceHistory);
+          history->samples = g_new (WnckResourceSample,
+                                    monitor->priv->history_length);
+          g_hash_table_insert (monitor->priv->histories, app, history);
+        }
+
+      if (history->n_samples > 0)
+        {
+          WnckResourceSample *last;
+
+          last = wnck_resource_history_get_sample (monitor, history,
+                                                   history->n_samples - 1);
+
+          if (memcmp (&last->usage, &sample.usage, sizeof (sample.usage)) != 0)
+            {
+              WnckResourceChange change;
+
+              change.app = app;
+              compute_delta (last, &sample, &change.delta);
+              g_array_append_val (changes, change);
+            }
+        }
+
+      /* the oldest sample is dropped when the ring buffer is full */
+      if (history->n_samples < monitor->priv->history_length)
+        history->n_samples++;
+      else
+        history->first = (history->first + 1) % monitor->priv->history_length;
+
+      *wnck_resource_history_get_sample (monitor, history,
+                                         history->n_samples - 1) = sample;
+    }
+
+  g_hash_table_destroy (app_clients);
+
+  g_object_ref (monitor);
+
+  for (i = 0; i < changes->len; i++)
+    {
+      WnckResourceChange *change;
+
+      change = &g_array_index (changes, WnckResourceChange, i);
+      g_signal_emit (G_OBJECT (monitor), signals[USAGE_CHANGED], 0,
+                     change->app, &change->delta);
+    }
+
+  g_object_unref (monitor);
+
+  g_array_free (changes, TRUE);
+}
+
+/**
+ * wnck_resource_monitor_get_history:
+ * @monitor: a #WnckResourceMonitor.
+ * @app: a #WnckApplication.
+ *
+ * Gets the samples of the X resource usage of @app kept by @monitor.
+ *
+ * Return value: (transfer full) (element-type WnckResourceSample): a newly
+ * allocated #GArray of #WnckResourceSample, from the oldest to the newest,
+ * or %NULL if there is no sample for @app. The array should be freed with
+ * g_array_free().
+ *
+ * Since: 3.4
+ */
+GArray *
+wnck_resource_monitor_get_history (WnckResourceMonitor *monitor,
+                                   WnckApplication     *app)
+{
+  WnckResourceHistory *history;
+  GArray *samples;
+  guint i;
+
+  g_return_val_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor), NULL);
+  g_return_val_if_fail (WNCK_IS_APPLICATION (app), NULL);
+
+  history = g_hash_table_lookup (monitor->priv->histories, app);
+  if (history == NULL || history->n_samples == 0)
+    return NULL;
+
+  samples = g_array_sized_new (FALSE, FALSE, sizeof (WnckResourceSample),
+                               history->n_samples);
+
+  for (i = 0; i < history->n_samples; i++)
+    g_array_append_vals (samples,
+                         wnck_resource_history_get_sample (monitor, history, i),
+                         1);
+
+  return samples;
+}
+
+/**
+ * wnck_resource_monitor_get_delta:
+ * @monitor: a #WnckResourceMonitor.
+ * @app: a #WnckApplication.
+ * @delta: return location for the difference between the oldest and the
+ * newest samples of @app.
+ *
+ * Gets the difference between the oldest and the newest samples of the X
+ * resource usage of @app kept by @monitor. For example, the growth of the
+ * pixmap bytes per minute is
+ * <literal>delta.pixmap_bytes * 60 * G_USEC_PER_SEC / delta.period</literal>.
+ *
+ * Return value: %TRUE if @monitor has at least two samples for @app and
+ * @delta was set, %FALSE otherwise.
+ *
+ * Since: 3.4
+ */
+gboolean
+wnck_resource_monitor_get_delta (WnckResourceMonitor    *monitor,
+                                 WnckApplication        *app,
+                                 WnckResourceUsageDelta *delta)
+{
+  WnckResourceHistory *history;
+
+  g_return_val_if_fail (WNCK_IS_RESOURCE_MONITOR (monitor), FALSE);
+  g_return_val_if_fail (WNCK_IS_APPLICATION (app), FALSE);
+  g_return_val_if_fail (delta != NULL, FALSE);
+
+  history = g_hash_table_lookup (monitor->priv->histories, app);
+  if (history == NULL || history->n_samples < 2)
+    return FALSE;
+
+  compute_delta (wnck_resource_history_get_sample (monitor, history, 0),
+                 wnck_resource_history_get_sample (monitor, history,
+                                                   history->n_samples - 1),
+                 delta);
+
+  return TRUE;
+}
@@ -0,0 +1,155 @@
+/* resource monitor object */
+/* vim: set sw=2 et: */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#if !defined (__LIBWNCK_H_INSIDE__) && !defined (WNCK_COMPILATION)
+#error "Only <libwnck/libwnck.h> can be included directly."
+#endif
+
+#ifndef WNCK_RESOURCE_MONITOR_H
+#define WNCK_RESOURCE_MONITOR_H
+
+#include <glib-object.h>
+#include <libwnck/screen.h>
+#include <libwnck/util.h>
+
+G_BEGIN_DECLS
+
+#define WNCK_TYPE_RESOURCE_MONITOR              (wnck_resource_monitor_get_type ())
+#define WNCK_RESOURCE_MONITOR(object)           (G_TYPE_CHECK_INSTANCE_CAST ((object), WNCK_TYPE_RESOURCE_MONITOR, WnckResourceMonitor))
+#define WNCK_RESOURCE_MONITOR_CLASS(klass)      (G_TYPE_CHECK_CLASS_CAST ((klass), WNCK_TYPE_RESOURCE_MONITOR, WnckResourceMonitorClass))
+#define WNCK_IS_RESOURCE_MONITOR(object)        (G_TYPE_CHECK_INSTANCE_TYPE ((object), WNCK_TYPE_RESOURCE_MONITOR))
+#define WNCK_IS_RESOURCE_MONITOR_CLASS(klass)   (G_TYPE_CHECK_CLASS_TYPE ((klass), WNCK_TYPE_RESOURCE_MONITOR))
+#define WNCK_RESOURCE_MONITOR_GET_CLASS(obj)    (G_TYPE_INSTANCE_GET_CLASS ((obj), WNCK_TYPE_RESOURCE_MONITOR, WnckResourceMonitorClass))
+
+typedef struct _WnckResourceMonitor        WnckResourceMonitor;
+typedef struct _WnckResourceMonitorClass   WnckResourceMonitorClass;
+typedef struct _WnckResourceMonitorPrivate WnckResourceMonitorPrivate;
+
+typedef struct _WnckResourceSample         WnckResourceSample;
+typedef struct _WnckResourceUsageDelta     WnckResourceUsageDelta;
+
+/**
+ * WnckResourceSample:
+ * @time: the monotonic time at which the sample was taken, in microseconds.
+ * @usage: the X resource usage at @time.
+ *
+ * The #WnckResourceSample struct contains the X resource usage of a
+ * #WnckApplication at a given time.
+ *
+ * Since: 3.4
+ */
+struct _WnckResourceSample
+{
+  gint64            time;
+  WnckResourceUsage usage;
+};
+
+/**
+ * WnckResourceUsageDelta:
+ * @period: the time between the two samples, in microseconds.
+ * @total_bytes_estimate: growth of the estimation of the total number of bytes
+ * allocated in the X server.
+ * @pixmap_bytes: growth of the number of bytes allocated for Pixmap resources.
+ * @n_pixmaps: growth of the number of Pixmap resources.
+ * @n_windows: growth of the number of Window resources.
+ * @n_gcs: growth of the number of GContext resources.
+ * @n_pictures: growth of the number of Picture resources.
+ * @n_glyphsets: growth of the number of Glyphset resources.
+ * @n_fonts: growth of the number of Font resources.
+ * @n_colormap_entries: growth of the number of Colormap resources.
+ * @n_passive_grabs: growth of the number of PassiveGrab resources.
+ * @n_cursors: growth of the number of Cursor resources.
+ * @n_other: growth of the number of other resources.
+ *
+ * The #WnckResourceUsageDelta struct contains the difference between two
+ * samples of the X resource usage of a #WnckApplication. A negative value
+ * means the usage decreased. Dividing a field by @period gives a growth rate.
+ *
+ * Since: 3.4
+ */
+struct _WnckResourceUsageDelta
+{
+  gint64 period;
+
+  glong  total_bytes_estimate;
+  glong  pixmap_bytes;
+
+  int    n_pixmaps;
+  int    n_windows;
+  int    n_gcs;
+  int    n_pictures;
+  int    n_glyphsets;
+  int    n_fonts;
+  int    n_colormap_entries;
+  int    n_passive_grabs;
+  int    n_cursors;
+  int    n_other;
+};
+
+/**
+ * WnckResourceMonitor:
+ *
+ * The #WnckResourceMonitor struct contains only private fields and should not
+ * be directly accessed.
+ */
+struct _WnckResourceMonitor
+{
+  GObject parent_instance;
+
+  WnckResourceMonitorPrivate *priv;
+};
+
+struct _WnckResourceMonitorClass
+{
+  GObjectClass parent_class;
+
+  void (* usage_changed) (WnckResourceMonitor          *monitor,
+                          WnckApplication              *app,
+                          const WnckResourceUsageDelta *delta);
+
+  /* Padding for future expansion */
+  void (* pad1) (void);
+  void (* pad2) (void);
+  void (* pad3) (void);
+  void (* pad4) (void);
+};
+
+GType wnck_resource_monitor_get_type (void) G_GNUC_CONST;
+
+WnckResourceMonitor *wnck_resource_monitor_new (WnckScreen *screen,
+                                                guint       interval,
+                                                guint       history_length);
+
+void     wnck_resource_monitor_set_interval       (WnckResourceMonitor *monitor,
+                                                   guint                interval);
+guint    wnck_resource_monitor_get_interval       (WnckResourceMonitor *monitor);
+guint    wnck_resource_monitor_get_history_length (WnckResourceMonitor *monitor);
+
+void     wnck_resource_monitor_sample             (WnckResourceMonitor *monitor);
+
+GArray  *wnck_resource_monitor_get_history        (WnckResourceMonitor *monitor,
+                                                   WnckApplication     *app);
+gboolean wnck_resource_monitor_get_delta          (WnckResourceMonitor    *monitor,
+                                                   WnckApplication        *app,
+                                                   WnckResourceUsageDelta *delta);
+
+G_END_DECLS
+
+#endif /* WNCK_RESOURCE_MONITOR_H */
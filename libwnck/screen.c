@@ -67,6 +67,9 @@
 #define _NET_WM_BOTTOMRIGHT 2
 #define _NET_WM_BOTTOMLEFT  3
 
+/* names read per second per window, see wnck_screen_set_name_rate_limit() */
+#define DEFAULT_NAME_RATE_LIMIT 10
+
 static WnckScreen** screens = NULL;
 
 struct _WnckScreenPrivate
@@ -81,8 +84,10 @@ struct _WnckScreenPrivate
   GList *mapped_windows;
   /* in stacking order */
   GList *stacked_windows;
-  /* in 0-to-N order */
-  GList *workspaces;
+  /* indexed by number */
+  GPtrArray *workspaces;
+  /* the same, as a list for wnck_screen_get_workspaces() */
+  GList *workspace_list;
 
   /* previously_active_window is used in tandem with active_window to
    * determine return status of wnck_window_is_most_recently_actived().
@@ -105,6 +110,12 @@ struct _WnckScreenPrivate
 
   guint update_handler;
 
+  /* properties of the windows we keep up to date */
+  WnckScreenInterest interest;
+
+  /* names read per second per window, or 0 */
+  guint name_rate_limit;
+
 #ifdef HAVE_STARTUP_NOTIFICATION
   SnDisplay *sn_display;
 #endif
@@ -116,6 +127,15 @@ struct _WnckScreenPrivate
   gint rows_of_workspaces;
   gint columns_of_workspaces;
 
+  /* grid of the workspace layout, computed again when the layout or the
+   * number of workspaces changes */
+  int *layout_grid; /* workspace in each cell, or -1 */
+  int *layout_cells; /* cell of each workspace, or -1 */
+  int layout_rows;
+  int layout_cols;
+  int layout_n_workspaces;
+  guint layout_valid : 1;
+
   /* if you add flags, be sure to set them
    * when we create the screen so we get an initial update
    */
@@ -159,6 +179,7 @@ static void wnck_screen_finalize    (GObject         *object);
 
 static void update_client_list        (WnckScreen      *screen);
 static void update_workspace_list     (WnckScreen      *screen);
+static void invalidate_workspace_layout (WnckScreen      *screen);
 static void update_viewport_settings  (WnckScreen      *screen);
 static void update_active_workspace   (WnckScreen      *screen);
 static void update_active_window      (WnckScreen      *screen);
@@ -208,7 +229,8 @@ wnck_screen_init (WnckScreen *screen)
 
   screen->priv->mapped_windows = NULL;
   screen->priv->stacked_windows = NULL;
-  screen->priv->workspaces = NULL;
+  screen->priv->workspaces = g_ptr_array_new ();
+  screen->priv->workspace_list = NULL;
 
   screen->priv->active_window = NULL;
   screen->priv->previously_active_window = NULL;
@@ -223,6 +245,9 @@ wnck_screen_init (WnckScreen *screen)
 
   screen->priv->update_handler = 0;
 
+  screen->priv->interest = WNCK_SCREEN_INTEREST_ALL;
+  screen->priv->name_rate_limit = DEFAULT_NAME_RATE_LIMIT;
+
 #ifdef HAVE_STARTUP_NOTIFICATION
   screen->priv->sn_display = NULL;
 #endif
@@ -234,6 +259,10 @@ wnck_screen_init (WnckScreen *screen)
   screen->priv->rows_of_workspaces = 1;
   screen->priv->columns_of_workspaces = -1;
 
+  screen->priv->layout_grid = NULL;
+  screen->priv->layout_cells = NULL;
+  screen->priv->layout_valid = FALSE;
+
   screen->priv->need_update_stack_list = FALSE;
   screen->priv->need_update_workspace_list = FALSE;
   screen->priv->need_update_viewport_settings = FALSE;
@@ -532,7 +561,7 @@ wnck_screen_finalize (GObject *object)
   for (tmp = screen->priv->mapped_windows; tmp; tmp = tmp->next)
     _wnck_window_destroy (WNCK_WINDOW (tmp->data));
 
-  for (tmp = screen->priv->workspaces; tmp; tmp = tmp->next)
+  for (tmp = screen->priv->workspace_list; tmp; tmp = tmp->next)
     g_object_unref (tmp->data);
 
   g_list_free (screen->priv->mapped_windows);
@@ -540,7 +569,9 @@ wnck_screen_finalize (GObject *object)
   g_list_free (screen->priv->stacked_windows);
   screen->priv->stacked_windows = NULL;
 
-  g_list_free (screen->priv->workspaces);
+  g_list_free (screen->priv->workspace_list);
+  screen->priv->workspace_list = NULL;
+  g_ptr_array_free (screen->priv->workspaces, TRUE);
   screen->priv->workspaces = NULL;
 
   weak_pointer = &screen->priv->active_window;
@@ -558,6 +589,8 @@ wnck_screen_finalize (GObject *object)
   g_free (screen->priv->wm_name);
   screen->priv->wm_name = NULL;
 
+  invalidate_workspace_layout (screen);
+
   screens[screen->priv->number] = NULL;
 
 #ifdef HAVE_STARTUP_NOTIFICATION
@@ -767,7 +800,7 @@ wnck_screen_get_workspaces (WnckScreen *screen)
 {
   g_return_val_if_fail (WNCK_IS_SCREEN (screen), NULL);
 
-  return screen->priv->workspaces;
+  return screen->priv->workspace_list;
 }
 
 /**
@@ -785,19 +818,16 @@ WnckWorkspace*
 wnck_screen_get_workspace (WnckScreen *screen,
 			   int         workspace)
 {
-  GList *list;
-
   g_return_val_if_fail (WNCK_IS_SCREEN (screen), NULL);
 
   /* We trust this function with property-provided numbers, it
    * must reliably return NULL on bad data
    */
-  list = g_list_nth (screen->priv->workspaces, workspace);
-
-  if (list == NULL)
+  if (workspace < 0 || (guint) workspace >= screen->priv->workspaces->len)
     return NULL;
 
-  return WNCK_WORKSPACE (list->data);
+  return WNCK_WORKSPACE (g_ptr_array_index (screen->priv->workspaces,
+                                            workspace));
 }
 
 /**
@@ -961,7 +991,7 @@ wnck_screen_get_workspace_count (WnckScreen *screen)
 {
   g_return_val_if_fail (WNCK_IS_SCREEN (screen), 0);
 
-  return g_list_length (screen->priv->workspaces);
+  return screen->priv->workspaces->len;
 }
 
 /**
@@ -994,13 +1024,13 @@ wnck_screen_change_workspace_count (WnckScreen *screen,
   xev.xclient.format = 32;
   xev.xclient.data.l[0] = count;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
               screen->priv->xroot,
               False,
               SubstructureRedirectMask | SubstructureNotifyMask,
               &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1078,40 +1108,18 @@ _wnck_screen_process_property_notify (WnckScreen *screen,
     }
 }
 
-/**
- * wnck_screen_calc_workspace_layout:
- * @screen: a #WnckScreen.
- * @num_workspaces: the number of #WnckWorkspace on @screen, or -1 to let
- * wnck_screen_calc_workspace_layout() find this number.
- * @space_index: the index of a #WnckWorkspace.
- * @layout: return location for the layout of #WnckWorkspace with additional
- * information.
- *
- * Calculates the layout of #WnckWorkspace, with additional information like
- * the row and column of the #WnckWorkspace with index @space_index.
- *
- * Since: 2.12
- * Deprecated:2.20:
- */
-/* TODO: when we make this private, remove num_workspaces since we can get it
- * from screen! */
-void
-wnck_screen_calc_workspace_layout (WnckScreen          *screen,
-                                   int                  num_workspaces,
-                                   int                  space_index,
-                                   WnckWorkspaceLayout *layout)
+/* Returns the grid of the workspace layout for @num_workspaces workspaces,
+ * with the workspace in each cell or -1 for empty cells. */
+static int *
+compute_workspace_layout_grid (WnckScreen *screen,
+                               int         num_workspaces,
+                               int        *rows_out,
+                               int        *cols_out)
 {
   int rows, cols;
   int grid_area;
   int *grid;
   int i, r, c;
-  int current_row, current_col;
-
-  g_return_if_fail (WNCK_IS_SCREEN (screen));
-  g_return_if_fail (layout != NULL);
-
-  if (num_workspaces < 0)
-    num_workspaces = wnck_screen_get_workspace_count (screen);
 
   rows = screen->priv->rows_of_workspaces;
   cols = screen->priv->columns_of_workspaces;
@@ -1136,8 +1144,6 @@ wnck_screen_calc_workspace_layout (WnckScreen          *screen,
 
   grid = g_new (int, grid_area);
 
-  current_row = -1;
-  current_col = -1;
   i = 0;
 
   switch (screen->priv->starting_corner)
@@ -1272,34 +1278,166 @@ wnck_screen_calc_workspace_layout (WnckScreen          *screen,
       break;
     }
 
-  current_row = 0;
-  current_col = 0;
-  r = 0;
-  while (r < rows)
+  /* flag nonexistent spaces with -1 */
+  for (i = 0; i < grid_area; i++)
+    if (grid[i] >= num_workspaces)
+      grid[i] = -1;
+
+  *rows_out = rows;
+  *cols_out = cols;
+
+  return grid;
+}
+
+static void
+invalidate_workspace_layout (WnckScreen *screen)
+{
+  g_free (screen->priv->layout_grid);
+  screen->priv->layout_grid = NULL;
+  g_free (screen->priv->layout_cells);
+  screen->priv->layout_cells = NULL;
+
+  screen->priv->layout_valid = FALSE;
+}
+
+static void
+ensure_workspace_layout (WnckScreen *screen)
+{
+  int n_spaces;
+  int i;
+
+  if (screen->priv->layout_valid)
+    return;
+
+  n_spaces = wnck_screen_get_workspace_count (screen);
+
+  screen->priv->layout_grid =
+    compute_workspace_layout_grid (screen, n_spaces,
+                                   &screen->priv->layout_rows,
+                                   &screen->priv->layout_cols);
+  screen->priv->layout_n_workspaces = n_spaces;
+
+  screen->priv->layout_cells = g_new (int, MAX (n_spaces, 1));
+  for (i = 0; i < n_spaces; i++)
+    screen->priv->layout_cells[i] = -1;
+
+  for (i = 0; i < screen->priv->layout_rows * screen->priv->layout_cols; i++)
+    if (screen->priv->layout_grid[i] >= 0)
+      screen->priv->layout_cells[screen->priv->layout_grid[i]] = i;
+
+  screen->priv->layout_valid = TRUE;
+}
+
+/* Gets the position of the workspace @space_index in the layout grid; the
+ * top left cell is at row 0 and column 0. Returns FALSE if the workspace is
+ * not in the grid. */
+gboolean
+_wnck_screen_get_workspace_layout_position (WnckScreen *screen,
+                                            int         space_index,
+                                            int        *row,
+                                            int        *column)
+{
+  int cell;
+
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), FALSE);
+
+  ensure_workspace_layout (screen);
+
+  if (space_index < 0 || space_index >= screen->priv->layout_n_workspaces)
+    return FALSE;
+
+  cell = screen->priv->layout_cells[space_index];
+  if (cell < 0)
+    return FALSE;
+
+  if (row)
+    *row = cell / screen->priv->layout_cols;
+  if (column)
+    *column = cell % screen->priv->layout_cols;
+
+  return TRUE;
+}
+
+/* Returns the index of the workspace at @row and @column in the layout grid,
+ * or -1 if there is none. */
+int
+_wnck_screen_get_workspace_at_layout_position (WnckScreen *screen,
+                                               int         row,
+                                               int         column)
+{
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), -1);
+
+  ensure_workspace_layout (screen);
+
+  if (row < 0 || row >= screen->priv->layout_rows ||
+      column < 0 || column >= screen->priv->layout_cols)
+    return -1;
+
+  return screen->priv->layout_grid[row * screen->priv->layout_cols + column];
+}
+
+/**
+ * wnck_screen_calc_workspace_layout:
+ * @screen: a #WnckScreen.
+ * @num_workspaces: the number of #WnckWorkspace on @screen, or -1 to let
+ * wnck_screen_calc_workspace_layout() find this number.
+ * @space_index: the index of a #WnckWorkspace.
+ * @layout: return location for the layout of #WnckWorkspace with additional
+ * information.
+ *
+ * Calculates the layout of #WnckWorkspace, with additional information like
+ * the row and column of the #WnckWorkspace with index @space_index.
+ *
+ * Since: 2.12
+ * Deprecated:2.20:
+ */
+/* TODO: when we make this private, remove num_workspaces since we can get it
+ * from screen! */
+void
+wnck_screen_calc_workspace_layout (WnckScreen          *screen,
+                                   int                  num_workspaces,
+                                   int                  space_index,
+                                   WnckWorkspaceLayout *layout)
+{
+  int rows, cols;
+  int *grid;
+
+  g_return_if_fail (WNCK_IS_SCREEN (screen));
+  g_return_if_fail (layout != NULL);
+
+  if (num_workspaces < 0)
+    num_workspaces = wnck_screen_get_workspace_count (screen);
+
+  if (num_workspaces == wnck_screen_get_workspace_count (screen))
     {
-      c = 0;
-      while (c < cols)
-        {
-          if (grid[r*cols+c] == space_index)
-            {
-              current_row = r;
-              current_col = c;
-            }
-          else if (grid[r*cols+c] >= num_workspaces)
-            {
-              /* flag nonexistent spaces with -1 */
-              grid[r*cols+c] = -1;
-            }
-          ++c;
-        }
-      ++r;
+      ensure_workspace_layout (screen);
+
+      rows = screen->priv->layout_rows;
+      cols = screen->priv->layout_cols;
+      grid = g_memdup (screen->priv->layout_grid, rows * cols * sizeof (int));
     }
+  else
+    grid = compute_workspace_layout_grid (screen, num_workspaces, &rows, &cols);
+
   layout->rows = rows;
   layout->cols = cols;
   layout->grid = grid;
-  layout->grid_area = grid_area;
-  layout->current_row = current_row;
-  layout->current_col = current_col;
+  layout->grid_area = rows * cols;
+  layout->current_row = 0;
+  layout->current_col = 0;
+
+  if (space_index >= 0 && space_index < num_workspaces)
+    {
+      int i;
+
+      for (i = 0; i < rows * cols; i++)
+        if (grid[i] == space_index)
+          {
+            layout->current_row = i / cols;
+            layout->current_col = i % cols;
+            break;
+          }
+    }
 }
 
 /**
@@ -1760,7 +1898,7 @@ update_workspace_list (WnckScreen *screen)
       n_spaces = 1;
     }
 
-  old_n_spaces = g_list_length (screen->priv->workspaces);
+  old_n_spaces = screen->priv->workspaces->len;
 
   deleted = NULL;
   created = NULL;
@@ -1773,13 +1911,15 @@ update_workspace_list (WnckScreen *screen)
   else if (old_n_spaces > n_spaces)
     {
       /* Need to delete some workspaces */
-      deleted = g_list_nth (screen->priv->workspaces, n_spaces);
+      deleted = g_list_nth (screen->priv->workspace_list, n_spaces);
       if (deleted->prev)
         deleted->prev->next = NULL;
       deleted->prev = NULL;
 
-      if (deleted == screen->priv->workspaces)
-        screen->priv->workspaces = NULL;
+      if (deleted == screen->priv->workspace_list)
+        screen->priv->workspace_list = NULL;
+
+      g_ptr_array_set_size (screen->priv->workspaces, n_spaces);
     }
   else
     {
@@ -1795,8 +1935,7 @@ update_workspace_list (WnckScreen *screen)
 
           space = _wnck_workspace_create (old_n_spaces + i, screen);
 
-          screen->priv->workspaces = g_list_append (screen->priv->workspaces,
-                                                    space);
+          g_ptr_array_add (screen->priv->workspaces, space);
 
           created = g_list_prepend (created, space);
 
@@ -1804,8 +1943,13 @@ update_workspace_list (WnckScreen *screen)
         }
 
       created = g_list_reverse (created);
+
+      screen->priv->workspace_list =
+        g_list_concat (screen->priv->workspace_list, g_list_copy (created));
     }
 
+  invalidate_workspace_layout (screen);
+
   /* Here we allow reentrancy, going into the main
    * loop could confuse us
    */
@@ -2040,6 +2184,8 @@ update_workspace_layout (WnckScreen *screen)
 
   screen->priv->need_update_workspace_layout = FALSE;
 
+  invalidate_workspace_layout (screen);
+
   list = NULL;
   n_items = 0;
   if (_wnck_get_cardinal_list (screen->priv->xscreen,
@@ -2141,7 +2287,7 @@ update_workspace_names (WnckScreen *screen)
                                screen->priv->xroot,
                                _wnck_atom_get ("_NET_DESKTOP_NAMES"));
 
-  copy = g_list_copy (screen->priv->workspaces);
+  copy = g_list_copy (screen->priv->workspace_list);
 
   i = 0;
   tmp = copy;
@@ -2580,6 +2726,34 @@ _wnck_screen_get_workspace_layout (WnckScreen             *screen,
     *starting_corner = screen->priv->starting_corner;
 }
 
+typedef struct
+{
+  WnckScreen *screen;
+  int         rows;
+  int         columns;
+} WnckLayoutRequest;
+
+static void
+layout_request_free (gpointer data)
+{
+  WnckLayoutRequest *request = data;
+
+  g_object_unref (request->screen);
+  g_slice_free (WnckLayoutRequest, request);
+}
+
+static void
+layout_manager_claimed (int      token,
+                        gboolean claimed,
+                        gpointer data)
+{
+  WnckLayoutRequest *request = data;
+
+  if (claimed)
+    _wnck_set_desktop_layout (request->screen->priv->xscreen,
+                              request->rows, request->columns);
+}
+
 /**
  * wnck_screen_try_set_workspace_layout:
  * @screen: a #WnckScreen.
@@ -2604,9 +2778,19 @@ _wnck_screen_get_workspace_layout (WnckScreen             *screen,
  * You have to release the ownership of the layout with
  * wnck_screen_release_workspace_layout() when you do not need it anymore.
  *
+ * This function does not wait for the X server: when nobody owns the layout,
+ * a new token is returned right away and the layout is set once the
+ * ownership has been obtained, from the main loop. Such a token is
+ * provisional until then: if the ownership cannot be obtained in the end, or
+ * is lost later, the layout is not set and the token is treated like a token
+ * that lost the ownership by the next call to
+ * wnck_screen_try_set_workspace_layout(), which tries to obtain the
+ * ownership again.
+ *
  * Return value: a token to use for future calls to
  * wnck_screen_try_set_workspace_layout() and to
- * wnck_screen_release_workspace_layout(), or 0 if the layout could not be set.
+ * wnck_screen_release_workspace_layout(), or 0 if another application owns
+ * the layout. A non-zero token does not mean the layout has been set yet.
  */
 int
 wnck_screen_try_set_workspace_layout (WnckScreen *screen,
@@ -2614,6 +2798,7 @@ wnck_screen_try_set_workspace_layout (WnckScreen *screen,
                                       int         rows,
                                       int         columns)
 {
+  WnckLayoutRequest *data;
   int retval;
 
   g_return_val_if_fail (WNCK_IS_SCREEN (screen),
@@ -2621,12 +2806,16 @@ wnck_screen_try_set_workspace_layout (WnckScreen *screen,
   g_return_val_if_fail (rows != 0 || columns != 0,
                         WNCK_NO_MANAGER_TOKEN);
 
-  retval = _wnck_try_desktop_layout_manager (screen->priv->xscreen, current_token);
+  data = g_slice_new (WnckLayoutRequest);
+  data->screen = g_object_ref (screen);
+  data->rows = rows;
+  data->columns = columns;
 
-  if (retval != WNCK_NO_MANAGER_TOKEN)
-    {
-      _wnck_set_desktop_layout (screen->priv->xscreen, rows, columns);
-    }
+  retval = _wnck_try_desktop_layout_manager (screen->priv->xscreen,
+                                             current_token,
+                                             layout_manager_claimed,
+                                             data,
+                                             layout_request_free);
 
   return retval;
 }
@@ -2715,6 +2904,115 @@ wnck_screen_move_viewport (WnckScreen *screen,
   _wnck_change_viewport (screen->priv->xscreen, x, y);
 }
 
+/**
+ * wnck_screen_set_interest:
+ * @screen: a #WnckScreen.
+ * @interest: the properties of #WnckWindow used by the application.
+ *
+ * Sets which properties of the #WnckWindow on @screen are kept up to date.
+ * Reading a property of a window and processing its changes has a cost, and
+ * most applications do not use all of them: a pager does not need icon names
+ * or allowed actions, for example. The properties that are not part of
+ * @interest are not read anymore, and the values returned for them, like the
+ * ones returned by wnck_window_get_name() or wnck_window_get_actions(), are
+ * not updated anymore. The icons are still read when wnck_window_get_icon()
+ * or wnck_window_get_mini_icon() is called, but #WnckWindow::icon-changed is
+ * not emitted for them, even when such a call finds a new icon.
+ *
+ * When a property is added to @interest, it is read again for all windows.
+ *
+ * Since the interest is shared by all the users of @screen in the
+ * application, this should only be used by applications that know which
+ * widgets they use. By default, all properties are kept up to date.
+ *
+ * Since: 3.4
+ */
+void
+wnck_screen_set_interest (WnckScreen         *screen,
+                          WnckScreenInterest  interest)
+{
+  WnckScreenInterest added;
+  GList *tmp;
+
+  g_return_if_fail (WNCK_IS_SCREEN (screen));
+
+  interest &= WNCK_SCREEN_INTEREST_ALL;
+
+  added = interest & ~screen->priv->interest;
+  screen->priv->interest = interest;
+
+  if (added == 0)
+    return;
+
+  for (tmp = screen->priv->mapped_windows; tmp; tmp = tmp->next)
+    _wnck_window_interest_added (WNCK_WINDOW (tmp->data), added);
+}
+
+/**
+ * wnck_screen_get_interest:
+ * @screen: a #WnckScreen.
+ *
+ * Gets which properties of the #WnckWindow on @screen are kept up to date.
+ * See wnck_screen_set_interest().
+ *
+ * Return value: the properties of #WnckWindow kept up to date.
+ *
+ * Since: 3.4
+ */
+WnckScreenInterest
+wnck_screen_get_interest (WnckScreen *screen)
+{
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), WNCK_SCREEN_INTEREST_ALL);
+
+  return screen->priv->interest;
+}
+
+/**
+ * wnck_screen_set_name_rate_limit:
+ * @screen: a #WnckScreen.
+ * @rate: the maximum number of times per second the name of a window is read,
+ * or 0 for no limit.
+ *
+ * Sets how often the name and the icon name of a #WnckWindow on @screen can be
+ * read. Some applications, like terminals or build tools, change the title of
+ * their windows many times per second to show their progress; reading each of
+ * those titles and emitting #WnckWindow::name-changed for each of them is
+ * costly. A change coming after a quiet period is still seen right away, and
+ * the latest name of a window is always read, at most 1/@rate second later.
+ *
+ * The default is 10 times per second.
+ *
+ * Since: 3.4
+ */
+void
+wnck_screen_set_name_rate_limit (WnckScreen *screen,
+                                 guint       rate)
+{
+  g_return_if_fail (WNCK_IS_SCREEN (screen));
+
+  screen->priv->name_rate_limit = rate;
+}
+
+/**
+ * wnck_screen_get_name_rate_limit:
+ * @screen: a #WnckScreen.
+ *
+ * Gets how often the name of a #WnckWindow on @screen can be read. See
+ * wnck_screen_set_name_rate_limit().
+ *
+ * Return value: the maximum number of times per second the name of a window is
+ * read, or 0 if there is no limit.
+ *
+ * Since: 3.4
+ */
+guint
+wnck_screen_get_name_rate_limit (WnckScreen *screen)
+{
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), 0);
+
+  return screen->priv->name_rate_limit;
+}
+
 #ifdef HAVE_STARTUP_NOTIFICATION
 SnDisplay*
 _wnck_screen_get_sn_display (WnckScreen *screen)
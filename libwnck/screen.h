@@ -193,6 +193,31 @@ typedef enum
   WNCK_LAYOUT_CORNER_BOTTOMLEFT
 } _WnckLayoutCorner;
 
+/**
+ * WnckScreenInterest:
+ * @WNCK_SCREEN_INTEREST_NAMES: the names of the #WnckWindow.
+ * @WNCK_SCREEN_INTEREST_ICON_NAMES: the icon names of the #WnckWindow.
+ * @WNCK_SCREEN_INTEREST_ICONS: the icons of the #WnckWindow.
+ * @WNCK_SCREEN_INTEREST_ACTIONS: the actions allowed on the #WnckWindow.
+ * @WNCK_SCREEN_INTEREST_FRAME_EXTENTS: the extents of the frames of the
+ * #WnckWindow.
+ * @WNCK_SCREEN_INTEREST_ALL: all the above.
+ *
+ * Type used as a bitmask to describe the properties of #WnckWindow that the
+ * application uses. See wnck_screen_set_interest().
+ *
+ * Since: 3.4
+ */
+typedef enum
+{
+  WNCK_SCREEN_INTEREST_NAMES         = 1 << 0,
+  WNCK_SCREEN_INTEREST_ICON_NAMES    = 1 << 1,
+  WNCK_SCREEN_INTEREST_ICONS         = 1 << 2,
+  WNCK_SCREEN_INTEREST_ACTIONS       = 1 << 3,
+  WNCK_SCREEN_INTEREST_FRAME_EXTENTS = 1 << 4,
+  WNCK_SCREEN_INTEREST_ALL           = (1 << 5) - 1
+} WnckScreenInterest;
+
 GType wnck_screen_get_type (void) G_GNUC_CONST;
 
 WnckScreen*    wnck_screen_get_default              (void);
@@ -223,6 +248,14 @@ void           wnck_screen_toggle_showing_desktop   (WnckScreen *screen,
 void           wnck_screen_move_viewport            (WnckScreen *screen,
                                                      int         x,
                                                      int         y);
+void           wnck_screen_set_name_rate_limit      (WnckScreen *screen,
+                                                     guint       rate);
+guint          wnck_screen_get_name_rate_limit      (WnckScreen *screen);
+
+void               wnck_screen_set_interest (WnckScreen         *screen,
+                                             WnckScreenInterest  interest);
+WnckScreenInterest wnck_screen_get_interest (WnckScreen         *screen);
+
 void           _wnck_screen_get_workspace_layout     (WnckScreen             *screen,
                                                       _WnckLayoutOrientation *orientation,
                                                       int                    *rows,
@@ -29,6 +29,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <gtk/gtk.h>
 
 #include <glib/gi18n-lib.h>
@@ -57,17 +59,56 @@ typedef struct
 {
   GtkWidget *item;
   GtkWidget *label;
+
+  int        section;
+  gboolean   visible;
+
+  /* normalized and case-folded names of the window, for the filter */
+  char      *search_key;
+  gboolean   matches;
 } window_hash_item;
 
+/* The menu is made of sections: section 0 contains the windows of the active
+ * workspace and the pinned windows, and is followed by a separator. Section
+ * n + 1 contains the windows of workspace n, after a header item with the name
+ * of the workspace. The "No Windows Open" item comes last.
+ * Knowing the size of each section lets us find where to insert an item and
+ * whether a header should be visible without walking the menu. */
+typedef struct
+{
+  GtkWidget *header;
+  int        n_items;
+  int        n_visible;
+} WnckSelectorSection;
+
+#define WNCK_SELECTOR_CURRENT_SECTION 0
+
 struct _WnckSelectorPrivate {
   GtkWidget  *image;
   WnckWindow *icon_window;
 
   /* those have the same lifecycle as the menu */
   GtkWidget  *menu;
+  GtkWidget  *separator;
   GtkWidget  *no_windows_item;
   GHashTable *window_hash;
 
+  GArray     *sections;
+  int         n_visible;
+
+  /* the menu is kept up to date in the background: changes are queued and
+   * applied from an idle handler, so showing the menu is instant */
+  guint       update_idle;
+  gboolean    needs_rebuild;
+  GHashTable *pending_windows;
+
+  /* type-ahead filter: the text typed by the user, its normalized form and
+   * the windows matching it */
+  GtkWidget  *filter_item;
+  GString    *filter_text;
+  char       *filter;
+  GPtrArray  *filter_matches;
+
   int size;
 };
 
@@ -89,7 +130,9 @@ static void wnck_selector_connect_to_window (WnckSelector      *selector,
 static void wnck_selector_insert_window (WnckSelector *selector,
                                          WnckWindow   *window);
 static void wnck_selector_append_window (WnckSelector *selector,
-                                         WnckWindow   *window);
+                                         WnckWindow   *window,
+                                         int           section);
+static void wnck_selector_rebuild_menu  (WnckSelector *selector);
 
 static gint
 wnck_selector_windows_compare (gconstpointer  a,
@@ -243,100 +286,527 @@ wnck_selector_set_active_window (WnckSelector *selector, WnckWindow *window)
   selector->priv->icon_window = window;
 }
 
+static WnckSelectorSection *
+wnck_selector_get_section (WnckSelector *selector,
+                           int           section)
+{
+  return &g_array_index (selector->priv->sections,
+                         WnckSelectorSection, section);
+}
+
+/* Position in the menu right after the last item of section */
+static int
+wnck_selector_get_section_end (WnckSelector *selector,
+                               int           section)
+{
+  WnckSelectorSection *s;
+  int                  position;
+  int                  i;
+
+  position = selector->priv->filter_item ? 1 : 0;
+
+  for (i = 0; i <= section; i++)
+    {
+      s = wnck_selector_get_section (selector, i);
+
+      if (i == WNCK_SELECTOR_CURRENT_SECTION + 1)
+        position++; /* the separator */
+      if (s->header)
+        position++;
+
+      position += s->n_items;
+    }
+
+  return position;
+}
+
+static void
+wnck_selector_update_separators (WnckSelector *selector)
+{
+  WnckSelectorSection *current;
+
+  current = wnck_selector_get_section (selector,
+                                       WNCK_SELECTOR_CURRENT_SECTION);
+
+  /* the separator is only useful between two visible windows */
+  if (selector->priv->separator)
+    gtk_widget_set_visible (selector->priv->separator,
+                            current->n_visible > 0 &&
+                            selector->priv->n_visible > current->n_visible);
+
+  if (selector->priv->no_windows_item)
+    gtk_widget_set_visible (selector->priv->no_windows_item,
+                            selector->priv->n_visible == 0);
+}
+
+static void
+wnck_selector_update_section (WnckSelector *selector,
+                              int           section)
+{
+  WnckSelectorSection *s;
+
+  s = wnck_selector_get_section (selector, section);
+
+  /* hide the workspace item if no visible window follows it */
+  if (s->header)
+    gtk_widget_set_visible (s->header, s->n_visible > 0);
+
+  wnck_selector_update_separators (selector);
+}
+
 static void
 wnck_selector_make_menu_consistent (WnckSelector *selector)
 {
-  GList     *l, *children;
-  int        workspace_n;
-  GtkWidget *workspace_item;
-  GtkWidget *separator;
-  gboolean   separator_is_first;
-  gboolean   separator_is_last;
-  gboolean   visible_window;
+  WnckSelectorSection *s;
+  guint                i;
 
-  workspace_n = -1;
-  workspace_item = NULL;
+  for (i = 0; i < selector->priv->sections->len; i++)
+    {
+      s = wnck_selector_get_section (selector, i);
 
-  separator = NULL;
-  separator_is_first = FALSE;
-  separator_is_last = FALSE;
+      if (s->header)
+        gtk_widget_set_visible (s->header, s->n_visible > 0);
+    }
 
-  visible_window = FALSE;
+  wnck_selector_update_separators (selector);
+}
 
-  children = gtk_container_get_children (GTK_CONTAINER (selector->priv->menu));
+static void
+wnck_selector_set_item_visible (WnckSelector     *selector,
+                                window_hash_item *item,
+                                gboolean          visible)
+{
+  WnckSelectorSection *s;
 
-  for (l = children; l; l = l->next)
+  if (item->visible == visible)
+    return;
+
+  s = wnck_selector_get_section (selector, item->section);
+
+  item->visible = visible;
+  gtk_widget_set_visible (item->item, visible);
+
+  if (visible)
     {
-      int i;
+      s->n_visible++;
+      selector->priv->n_visible++;
+    }
+  else
+    {
+      s->n_visible--;
+      selector->priv->n_visible--;
+    }
+}
 
-      i = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (l->data),
-                                              "wnck-selector-workspace-n"));
+static void
+window_hash_item_free (gpointer data)
+{
+  window_hash_item *item = data;
 
-      if (i > 0)
-        {
-          workspace_n = i - 1;
+  g_free (item->search_key);
+  g_free (item);
+}
+
+static char *
+wnck_selector_normalize_text (const char *text)
+{
+  char *normalized;
+  char *folded;
 
-          /* we have two consecutive workspace items => hide the first */
-          if (workspace_item)
-            gtk_widget_hide (workspace_item);
+  normalized = g_utf8_normalize (text, -1, G_NORMALIZE_ALL);
+  if (!normalized)
+    return g_strdup ("");
 
-          workspace_item = GTK_WIDGET (l->data);
-        }
-      else if (GTK_IS_SEPARATOR_MENU_ITEM (l->data))
+  folded = g_utf8_casefold (normalized, -1);
+  g_free (normalized);
+
+  return folded;
+}
+
+static char *
+wnck_selector_get_search_key (WnckWindow *window)
+{
+  const char *class_group;
+  const char *class_instance;
+  char       *text;
+  char       *key;
+
+  class_group = wnck_window_get_class_group_name (window);
+  class_instance = wnck_window_get_class_instance_name (window);
+
+  text = g_strdup_printf ("%s\n%s\n%s\n%s",
+                          wnck_window_get_name (window),
+                          wnck_window_get_icon_name (window),
+                          class_group ? class_group : "",
+                          class_instance ? class_instance : "");
+  key = wnck_selector_normalize_text (text);
+  g_free (text);
+
+  return key;
+}
+
+static char *
+wnck_selector_get_section_search_key (WnckSelector *selector,
+                                      int           section)
+{
+  WnckScreen    *screen;
+  WnckWorkspace *workspace;
+
+  screen = wnck_selector_get_screen (selector);
+
+  if (section == WNCK_SELECTOR_CURRENT_SECTION)
+    workspace = wnck_screen_get_active_workspace (screen);
+  else
+    workspace = wnck_screen_get_workspace (screen, section - 1);
+
+  if (!workspace)
+    return g_strdup ("");
+
+  return wnck_selector_normalize_text (wnck_workspace_get_name (workspace));
+}
+
+static gboolean
+wnck_selector_item_matches (WnckSelector     *selector,
+                            window_hash_item *item,
+                            char            **section_keys)
+{
+  char     *section_key;
+  gboolean  retval;
+
+  if (!selector->priv->filter)
+    return TRUE;
+
+  if (strstr (item->search_key, selector->priv->filter))
+    return TRUE;
+
+  if (section_keys)
+    return strstr (section_keys[item->section], selector->priv->filter) != NULL;
+
+  section_key = wnck_selector_get_section_search_key (selector, item->section);
+  retval = strstr (section_key, selector->priv->filter) != NULL;
+  g_free (section_key);
+
+  return retval;
+}
+
+static void
+wnck_selector_update_item_visible (WnckSelector     *selector,
+                                   window_hash_item *item,
+                                   WnckWindow       *window)
+{
+  wnck_selector_set_item_visible (selector, item,
+                                  item->matches &&
+                                  !wnck_window_is_skip_tasklist (window));
+}
+
+/* Updates item->matches, and the list of matching windows */
+static void
+wnck_selector_update_item_match (WnckSelector     *selector,
+                                 window_hash_item *item,
+                                 WnckWindow       *window,
+                                 char            **section_keys)
+{
+  gboolean matches;
+
+  matches = wnck_selector_item_matches (selector, item, section_keys);
+
+  if (selector->priv->filter && matches && !item->matches)
+    g_ptr_array_add (selector->priv->filter_matches, window);
+  else if (selector->priv->filter && !matches && item->matches)
+    g_ptr_array_remove_fast (selector->priv->filter_matches, window);
+
+  item->matches = matches;
+
+  wnck_selector_update_item_visible (selector, item, window);
+}
+
+static char **
+wnck_selector_get_section_search_keys (WnckSelector *selector)
+{
+  char  **keys;
+  guint   i;
+
+  keys = g_new0 (char *, selector->priv->sections->len + 1);
+
+  for (i = 0; i < selector->priv->sections->len; i++)
+    keys[i] = wnck_selector_get_section_search_key (selector, i);
+
+  return keys;
+}
+
+static void
+wnck_selector_apply_filter (WnckSelector *selector,
+                            gboolean      narrowing)
+{
+  window_hash_item *item;
+  GHashTableIter    iter;
+  gpointer          key, value;
+  GPtrArray        *candidates;
+  char            **section_keys;
+  guint             i;
+
+  section_keys = NULL;
+  if (selector->priv->filter)
+    section_keys = wnck_selector_get_section_search_keys (selector);
+
+  if (narrowing)
+    {
+      /* only the windows matching the previous filter can match this one */
+      candidates = selector->priv->filter_matches;
+      selector->priv->filter_matches = g_ptr_array_new ();
+
+      for (i = 0; i < candidates->len; i++)
         {
-          if (!visible_window)
-            separator_is_first = TRUE;
-          separator_is_last = TRUE;
-          separator = GTK_WIDGET (l->data);
+          item = g_hash_table_lookup (selector->priv->window_hash,
+                                      g_ptr_array_index (candidates, i));
+          item->matches = FALSE;
+          wnck_selector_update_item_match (selector, item,
+                                           g_ptr_array_index (candidates, i),
+                                           section_keys);
         }
-      else if (gtk_widget_get_visible (l->data) &&
-               l->data != selector->priv->no_windows_item)
+
+      g_ptr_array_free (candidates, TRUE);
+    }
+  else
+    {
+      g_ptr_array_set_size (selector->priv->filter_matches, 0);
+
+      g_hash_table_iter_init (&iter, selector->priv->window_hash);
+      while (g_hash_table_iter_next (&iter, &key, &value))
         {
-          separator_is_last = FALSE;
-          visible_window = TRUE;
+          item = value;
+          item->matches = FALSE;
+          wnck_selector_update_item_match (selector, item, key, section_keys);
+        }
+    }
 
-          /* if we know of a workspace item that was not shown */
-          if (workspace_item)
-            {
-              WnckWindow    *window;
-              WnckWorkspace *workspace;
-
-              window = g_object_get_data (G_OBJECT (l->data),
-                                          "wnck-selector-window");
-
-              if (window)
-                {
-                  workspace = wnck_window_get_workspace (window);
-                  if (workspace &&
-                      workspace_n == wnck_workspace_get_number (workspace))
-                    {
-                      gtk_widget_show (workspace_item);
-                      workspace_n = -1;
-                      workspace_item = NULL;
-                    }
-                }
-            }
-        } /* end if (normal item) */
+  g_strfreev (section_keys);
+
+  wnck_selector_make_menu_consistent (selector);
+}
+
+static void
+wnck_selector_update_filter (WnckSelector *selector)
+{
+  char     *old_filter;
+  char     *label;
+  gboolean  narrowing;
+
+  old_filter = selector->priv->filter;
+
+  if (selector->priv->filter_text->len > 0)
+    selector->priv->filter = wnck_selector_normalize_text (selector->priv->filter_text->str);
+  else
+    selector->priv->filter = NULL;
+
+  narrowing = (old_filter && selector->priv->filter &&
+               g_str_has_prefix (selector->priv->filter, old_filter));
+  g_free (old_filter);
+
+  if (!wnck_selector_menu_is_built (selector))
+    return;
+
+  wnck_selector_apply_filter (selector, narrowing);
+
+  if (selector->priv->filter_item)
+    {
+      label = g_strdup_printf (_("Filter: %s"),
+                               selector->priv->filter_text->str);
+      gtk_label_set_text (GTK_LABEL (gtk_bin_get_child (GTK_BIN (selector->priv->filter_item))),
+                          label);
+      g_free (label);
+
+      gtk_widget_set_visible (selector->priv->filter_item,
+                              selector->priv->filter != NULL);
     }
 
-  g_list_free (children);
+  if (gtk_widget_get_visible (selector->priv->menu))
+    {
+      gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+      gtk_menu_shell_select_first (GTK_MENU_SHELL (selector->priv->menu), TRUE);
+    }
+}
+
+static void
+wnck_selector_reset_filter (WnckSelector *selector)
+{
+  if (selector->priv->filter_text->len == 0)
+    return;
+
+  g_string_truncate (selector->priv->filter_text, 0);
+  wnck_selector_update_filter (selector);
+}
+
+static gboolean
+wnck_selector_menu_key_press (GtkWidget    *menu,
+                              GdkEventKey  *event,
+                              WnckSelector *selector)
+{
+  GString  *text;
+  gunichar  c;
+  char     *prev;
 
-  /* do we have a trailing workspace item to be hidden? */
-  if (workspace_item)
-    gtk_widget_hide (workspace_item);
+  if (!wnck_selector_menu_is_built (selector))
+    return FALSE;
 
-  if (separator)
+  if (event->state & (GDK_CONTROL_MASK | GDK_MOD1_MASK))
+    return FALSE;
+
+  text = selector->priv->filter_text;
+
+  switch (event->keyval)
     {
-      if (separator_is_first || separator_is_last)
-        gtk_widget_hide (separator);
-      else
-        gtk_widget_show (separator);
+    case GDK_KEY_BackSpace:
+      if (text->len == 0)
+        return FALSE;
+      prev = g_utf8_find_prev_char (text->str, text->str + text->len);
+      g_string_truncate (text, prev ? prev - text->str : 0);
+      break;
+
+    case GDK_KEY_Escape:
+      /* the first escape clears the filter, the next one closes the menu */
+      if (text->len == 0)
+        return FALSE;
+      g_string_truncate (text, 0);
+      break;
+
+    default:
+      c = gdk_keyval_to_unicode (event->keyval);
+      if (c == 0 || !g_unichar_isprint (c))
+        return FALSE;
+      /* space activates the selected item, unless we are typing */
+      if (c == ' ' && text->len == 0)
+        return FALSE;
+      g_string_append_unichar (text, c);
+      break;
     }
 
-  if (visible_window)
-    gtk_widget_hide (selector->priv->no_windows_item);
-  else
-    gtk_widget_show (selector->priv->no_windows_item);
+  wnck_selector_update_filter (selector);
+
+  return TRUE;
+}
+
+static void
+wnck_selector_remove_window (WnckSelector *selector,
+                             WnckWindow   *window)
+{
+  window_hash_item    *item;
+  WnckSelectorSection *s;
+  int                  section;
+
+  item = g_hash_table_lookup (selector->priv->window_hash, window);
+  if (!item)
+    return;
+
+  wnck_selector_set_item_visible (selector, item, FALSE);
+
+  if (selector->priv->filter && item->matches)
+    g_ptr_array_remove_fast (selector->priv->filter_matches, window);
+
+  section = item->section;
+  s = wnck_selector_get_section (selector, section);
+  s->n_items--;
+
+  gtk_widget_destroy (item->item);
+  g_hash_table_remove (selector->priv->window_hash, window);
+
+  wnck_selector_update_section (selector, section);
+}
+
+/* Whether the sections describe the current menu */
+static gboolean
+wnck_selector_menu_is_built (WnckSelector *selector)
+{
+  return (selector->priv->menu != NULL &&
+          selector->priv->window_hash != NULL &&
+          !selector->priv->needs_rebuild);
+}
+
+static void
+wnck_selector_menu_changed (WnckSelector *selector)
+{
+  if (gtk_widget_get_visible (selector->priv->menu))
+    gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+}
+
+static void
+wnck_selector_flush_updates (WnckSelector *selector)
+{
+  GHashTableIter iter;
+  gpointer       window;
+
+  if (selector->priv->update_idle != 0)
+    {
+      g_source_remove (selector->priv->update_idle);
+      selector->priv->update_idle = 0;
+    }
+
+  if (!selector->priv->menu)
+    return;
+
+  if (selector->priv->needs_rebuild || !selector->priv->window_hash)
+    {
+      g_hash_table_remove_all (selector->priv->pending_windows);
+      wnck_selector_rebuild_menu (selector);
+      selector->priv->needs_rebuild = FALSE;
+      return;
+    }
+
+  if (g_hash_table_size (selector->priv->pending_windows) == 0)
+    return;
+
+  g_hash_table_iter_init (&iter, selector->priv->pending_windows);
+  while (g_hash_table_iter_next (&iter, &window, NULL))
+    {
+      /* destroy the item and recreate one so it's at the right position */
+      if (g_hash_table_lookup (selector->priv->window_hash, window))
+        wnck_selector_remove_window (selector, window);
+      wnck_selector_insert_window (selector, window);
+    }
+
+  g_hash_table_remove_all (selector->priv->pending_windows);
+
+  wnck_selector_menu_changed (selector);
+}
+
+static gboolean
+wnck_selector_update_idle (gpointer data)
+{
+  WnckSelector *selector = WNCK_SELECTOR (data);
+
+  selector->priv->update_idle = 0;
+
+  wnck_selector_flush_updates (selector);
+
+  return FALSE;
+}
+
+static void
+wnck_selector_queue_update (WnckSelector *selector)
+{
+  if (selector->priv->update_idle == 0)
+    selector->priv->update_idle = g_idle_add_full (G_PRIORITY_LOW,
+                                                   wnck_selector_update_idle,
+                                                   selector, NULL);
+}
+
+static void
+wnck_selector_queue_window (WnckSelector *selector,
+                            WnckWindow   *window)
+{
+  if (selector->priv->needs_rebuild)
+    return;
+
+  g_hash_table_insert (selector->priv->pending_windows, window, window);
+  wnck_selector_queue_update (selector);
+}
+
+static void
+wnck_selector_queue_rebuild (WnckSelector *selector)
+{
+  selector->priv->needs_rebuild = TRUE;
+  g_hash_table_remove_all (selector->priv->pending_windows);
+  wnck_selector_queue_update (selector);
 }
 
 static void
@@ -365,6 +835,21 @@ wnck_selector_window_icon_changed (WnckWindow *window,
     }
 }
 
+static void
+wnck_selector_update_item_search_key (WnckSelector     *selector,
+                                      window_hash_item *item,
+                                      WnckWindow       *window)
+{
+  g_free (item->search_key);
+  item->search_key = wnck_selector_get_search_key (window);
+
+  if (selector->priv->filter && wnck_selector_menu_is_built (selector))
+    {
+      wnck_selector_update_item_match (selector, item, window, NULL);
+      wnck_selector_update_section (selector, item->section);
+    }
+}
+
 static void
 wnck_selector_window_name_changed (WnckWindow *window,
                                    WnckSelector *selector)
@@ -384,9 +869,26 @@ wnck_selector_window_name_changed (WnckWindow *window,
       window_name = _wnck_window_get_name_for_display (window, FALSE, TRUE);
       gtk_label_set_text (GTK_LABEL (item->label), window_name);
       g_free (window_name);
+
+      wnck_selector_update_item_search_key (selector, item, window);
     }
 }
 
+/* the class names are part of the search key */
+static void
+wnck_selector_window_class_changed (WnckWindow   *window,
+                                    WnckSelector *selector)
+{
+  window_hash_item *item;
+
+  if (!selector->priv->window_hash)
+    return;
+
+  item = g_hash_table_lookup (selector->priv->window_hash, window);
+  if (item != NULL)
+    wnck_selector_update_item_search_key (selector, item, window);
+}
+
 static void
 wnck_selector_window_state_changed (WnckWindow *window,
                                     WnckWindowState changed_mask,
@@ -414,16 +916,13 @@ wnck_selector_window_state_changed (WnckWindow *window,
   if (item == NULL)
     return;
 
-  if (changed_mask & WNCK_WINDOW_STATE_SKIP_TASKLIST)
+  if (changed_mask & WNCK_WINDOW_STATE_SKIP_TASKLIST &&
+      wnck_selector_menu_is_built (selector))
     {
-      if (wnck_window_is_skip_tasklist (window))
-        gtk_widget_hide (item->item);
-      else
-        gtk_widget_show (item->item);
+      wnck_selector_update_item_visible (selector, item, window);
+      wnck_selector_update_section (selector, item->section);
 
-      wnck_selector_make_menu_consistent (selector);
-
-      gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+      wnck_selector_menu_changed (selector);
     }
 
   if (changed_mask &
@@ -449,28 +948,7 @@ static void
 wnck_selector_window_workspace_changed (WnckWindow   *window,
                                         WnckSelector *selector)
 {
-  window_hash_item *item;
-
-  item = NULL;
-
-  if (!selector->priv->menu || !gtk_widget_get_visible (selector->priv->menu))
-    return;
-
-  if (!selector->priv->window_hash)
-    return;
-
-  item = g_hash_table_lookup (selector->priv->window_hash, window);
-  if (!item)
-    return;
-
-  /* destroy the item and recreate one so it's at the right position */
-  gtk_widget_destroy (item->item);
-  g_hash_table_remove (selector->priv->window_hash, window);
-
-  wnck_selector_insert_window (selector, window);
-  wnck_selector_make_menu_consistent (selector);
-
-  gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+  wnck_selector_queue_window (selector, window);
 }
 
 static void
@@ -486,6 +964,35 @@ wnck_selector_active_window_changed (WnckScreen   *screen,
     wnck_selector_set_active_window (selector, window);
 }
 
+static void
+wnck_selector_active_workspace_changed (WnckScreen    *screen,
+                                        WnckWorkspace *previous_workspace,
+                                        WnckSelector  *selector)
+{
+  WnckWorkspace *workspace;
+  GHashTableIter iter;
+  gpointer       key, value;
+  int            section;
+
+  if (!wnck_selector_menu_is_built (selector))
+    return;
+
+  workspace = wnck_screen_get_active_workspace (screen);
+  section = workspace ? wnck_workspace_get_number (workspace) + 1 : -1;
+
+  /* only the windows leaving or joining the current workspace section move */
+  g_hash_table_iter_init (&iter, selector->priv->window_hash);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      window_hash_item *item = value;
+
+      if ((item->section == WNCK_SELECTOR_CURRENT_SECTION &&
+           !wnck_window_is_pinned (key)) ||
+          item->section == section)
+        wnck_selector_queue_window (selector, key);
+    }
+}
+
 static void
 wnck_selector_activate_window (WnckWindow *window)
 {
@@ -609,6 +1116,8 @@ wnck_selector_item_new (WnckSelector *selector,
       hash_item = g_new0 (window_hash_item, 1);
       hash_item->item = item;
       hash_item->label = ellipsizing_label;
+      hash_item->section = -1;
+      hash_item->visible = FALSE;
       g_hash_table_insert (selector->priv->window_hash, window, hash_item);
     }
 
@@ -671,10 +1180,11 @@ wnck_selector_workspace_label_style_updated (GtkLabel      *label,
   wnck_selector_workspace_name_changed (workspace, label);
 }
 
-static void
+static GtkWidget *
 wnck_selector_add_workspace (WnckSelector *selector,
                              WnckScreen   *screen,
-                             int           workspace_n)
+                             int           workspace_n,
+                             int           position)
 {
   WnckWorkspace *workspace;
   GtkWidget     *item;
@@ -700,18 +1210,43 @@ wnck_selector_add_workspace (WnckSelector *selector,
 
   gtk_container_add (GTK_CONTAINER (item), label);
 
-  gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu), item);
+  gtk_menu_shell_insert (GTK_MENU_SHELL (selector->priv->menu),
+                         item, position);
 
-  g_object_set_data (G_OBJECT (item), "wnck-selector-workspace-n",
-                     GINT_TO_POINTER (workspace_n + 1));
+  return item;
 }
 
-static GtkWidget *
-wnck_selector_create_window (WnckSelector *selector, WnckWindow *window)
+static int
+wnck_selector_get_window_section (WnckSelector *selector,
+                                  WnckWindow   *window)
 {
-  GtkWidget *item;
-  GtkWidget *image;
-  char *name;
+  WnckScreen    *screen;
+  WnckWorkspace *workspace;
+
+  screen = wnck_selector_get_screen (selector);
+  workspace = wnck_window_get_workspace (window);
+
+  if (!workspace && !wnck_window_is_pinned (window))
+    return -1;
+
+  /* window is pinned or in the current workspace */
+  if (!workspace || workspace == wnck_screen_get_active_workspace (screen))
+    return WNCK_SELECTOR_CURRENT_SECTION;
+
+  return wnck_workspace_get_number (workspace) + 1;
+}
+
+static void
+wnck_selector_add_window (WnckSelector *selector,
+                          WnckWindow   *window,
+                          int           section,
+                          int           position)
+{
+  GtkWidget           *item;
+  GtkWidget           *image;
+  window_hash_item    *hash_item;
+  WnckSelectorSection *s;
+  char                *name;
 
   name = _wnck_window_get_name_for_display (window, FALSE, TRUE);
 
@@ -731,90 +1266,39 @@ wnck_selector_create_window (WnckSelector *selector, WnckWindow *window)
                             G_CALLBACK (wnck_selector_activate_window),
                             window);
 
-  if (!wnck_window_is_skip_tasklist (window))
-    gtk_widget_show (item);
+  gtk_menu_shell_insert (GTK_MENU_SHELL (selector->priv->menu),
+                         item, position);
 
-  g_object_set_data (G_OBJECT (item), "wnck-selector-window", window);
+  s = wnck_selector_get_section (selector, section);
+  s->n_items++;
 
-  return item;
+  hash_item = g_hash_table_lookup (selector->priv->window_hash, window);
+  hash_item->section = section;
+  hash_item->search_key = wnck_selector_get_search_key (window);
+  wnck_selector_update_item_match (selector, hash_item, window, NULL);
 }
 
 static void
 wnck_selector_insert_window (WnckSelector *selector, WnckWindow *window)
 {
-  GtkWidget     *item;
-  WnckScreen    *screen;
-  WnckWorkspace *workspace;
-  int            workspace_n;
-  int            i;
+  int section;
 
-  screen = wnck_selector_get_screen (selector);
-  workspace = wnck_window_get_workspace (window);
+  section = wnck_selector_get_window_section (selector, window);
 
-  if (!workspace && !wnck_window_is_pinned (window))
+  if (section < 0 || section >= (int) selector->priv->sections->len)
     return;
 
-  item = wnck_selector_create_window (selector, window);
-
-  if (!workspace || workspace == wnck_screen_get_active_workspace (screen))
-    {
-      /* window is pinned or in the current workspace
-       * => insert before the separator */
-      GList *l, *children;
-
-      i = 0;
-
-      children = gtk_container_get_children (GTK_CONTAINER (selector->priv->menu));
-      for (l = children; l; l = l->next)
-        {
-          if (GTK_IS_SEPARATOR_MENU_ITEM (l->data))
-            break;
-          i++;
-        }
-      g_list_free (children);
-
-      gtk_menu_shell_insert (GTK_MENU_SHELL (selector->priv->menu),
-                             item, i);
-    }
-  else
-    {
-      workspace_n = wnck_workspace_get_number (workspace);
-
-      if (workspace_n == wnck_screen_get_workspace_count (screen) - 1)
-        /* window is in last workspace => just append */
-        gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu), item);
-      else
-        {
-          /* insert just before the next workspace item */
-          GList *l, *children;
-
-          i = 0;
-
-          children = gtk_container_get_children (GTK_CONTAINER (selector->priv->menu));
-          for (l = children; l; l = l->next)
-            {
-              int j;
-              j = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (l->data),
-                                                      "wnck-selector-workspace-n"));
-              if (j - 1 == workspace_n + 1)
-                break;
-              i++;
-            }
-          g_list_free (children);
-
-          gtk_menu_shell_insert (GTK_MENU_SHELL (selector->priv->menu),
-                                 item, i);
-        }
-    }
+  wnck_selector_add_window (selector, window, section,
+                            wnck_selector_get_section_end (selector, section));
+  wnck_selector_update_section (selector, section);
 }
 
 static void
-wnck_selector_append_window (WnckSelector *selector, WnckWindow *window)
+wnck_selector_append_window (WnckSelector *selector,
+                             WnckWindow   *window,
+                             int           section)
 {
-  GtkWidget *item;
-
-  item = wnck_selector_create_window (selector, window);
-  gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu), item);
+  wnck_selector_add_window (selector, window, section, -1);
 }
 
 static void
@@ -823,43 +1307,27 @@ wnck_selector_window_opened (WnckScreen *screen,
 {
   wnck_selector_connect_to_window (selector, window);
 
-  if (!selector->priv->menu || !gtk_widget_get_visible (selector->priv->menu))
-    return;
-
-  if (!selector->priv->window_hash)
-    return;
-
-  wnck_selector_insert_window (selector, window);
-  wnck_selector_make_menu_consistent (selector);
-
-  gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+  wnck_selector_queue_window (selector, window);
 }
 
 static void
 wnck_selector_window_closed (WnckScreen *screen,
                              WnckWindow *window, WnckSelector *selector)
 {
-  window_hash_item *item;
-
   if (window == selector->priv->icon_window)
     wnck_selector_set_active_window (selector, NULL);
 
-  if (!selector->priv->menu || !gtk_widget_get_visible (selector->priv->menu))
-    return;
+  g_hash_table_remove (selector->priv->pending_windows, window);
 
-  if (!selector->priv->window_hash)
+  if (!wnck_selector_menu_is_built (selector))
     return;
 
-  item = g_hash_table_lookup (selector->priv->window_hash, window);
-  if (!item)
+  if (!g_hash_table_lookup (selector->priv->window_hash, window))
     return;
 
-  g_object_set_data (G_OBJECT (item->item), "wnck-selector-window", NULL);
-
-  gtk_widget_hide (item->item);
-  wnck_selector_make_menu_consistent (selector);
+  wnck_selector_remove_window (selector, window);
 
-  gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+  wnck_selector_menu_changed (selector);
 }
 
 static void
@@ -867,18 +1335,28 @@ wnck_selector_workspace_created (WnckScreen    *screen,
                                  WnckWorkspace *workspace,
                                  WnckSelector  *selector)
 {
-  if (!selector->priv->menu || !gtk_widget_get_visible (selector->priv->menu))
+  WnckSelectorSection s;
+  int                 last;
+
+  if (!wnck_selector_menu_is_built (selector))
     return;
 
   /* this is assuming that the new workspace will have a higher number
    * than all the old workspaces, which is okay since the old workspaces
    * didn't disappear in the meantime */
-  wnck_selector_add_workspace (selector, screen,
-                               wnck_workspace_get_number (workspace));
+  last = selector->priv->sections->len - 1;
 
-  wnck_selector_make_menu_consistent (selector);
+  s.header = wnck_selector_add_workspace (selector, screen,
+                                          wnck_workspace_get_number (workspace),
+                                          wnck_selector_get_section_end (selector,
+                                                                         last));
+  s.n_items = 0;
+  s.n_visible = 0;
+  g_array_append_val (selector->priv->sections, s);
+
+  wnck_selector_update_section (selector, last + 1);
 
-  gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+  wnck_selector_menu_changed (selector);
 }
 
 static void
@@ -886,44 +1364,56 @@ wnck_selector_workspace_destroyed (WnckScreen    *screen,
                                    WnckWorkspace *workspace,
                                    WnckSelector  *selector)
 {
-  GList     *l, *children;
-  GtkWidget *destroy;
-  int        i;
+  GHashTableIter       iter;
+  gpointer             key, value;
+  GList               *orphans, *l;
+  WnckSelectorSection *s;
+  int                  section;
 
-  if (!selector->priv->menu || !gtk_widget_get_visible (selector->priv->menu))
+  if (!wnck_selector_menu_is_built (selector))
     return;
 
-  destroy = NULL;
-
-  i = wnck_workspace_get_number (workspace);
+  section = wnck_workspace_get_number (workspace) + 1;
+  if (section >= (int) selector->priv->sections->len)
+    return;
 
-  /* search for the item of this workspace so that we destroy it */
-  children = gtk_container_get_children (GTK_CONTAINER (selector->priv->menu));
+  /* the windows still listed in the section of this workspace will be moved
+   * to the right section; the following sections are shifted */
+  orphans = NULL;
 
-  for (l = children; l; l = l->next)
+  g_hash_table_iter_init (&iter, selector->priv->window_hash);
+  while (g_hash_table_iter_next (&iter, &key, &value))
     {
-      int j;
+      window_hash_item *item = value;
 
-      j = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (l->data),
-                           "wnck-selector-workspace-n"));
+      if (item->section == section)
+        orphans = g_list_prepend (orphans, key);
+    }
+
+  for (l = orphans; l; l = l->next)
+    wnck_selector_remove_window (selector, l->data);
 
+  g_hash_table_iter_init (&iter, selector->priv->window_hash);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      window_hash_item *item = value;
 
-      if (j - 1 == i)
-        destroy = GTK_WIDGET (l->data);
-      else if (j - 1 > i)
-        /* shift the following workspaces */
-        g_object_set_data (G_OBJECT (l->data), "wnck-selector-workspace-n",
-                           GINT_TO_POINTER (j - 1));
+      if (item->section > section)
+        item->section--;
     }
 
-  g_list_free (children);
+  s = wnck_selector_get_section (selector, section);
+  if (s->header)
+    gtk_widget_destroy (s->header);
+  g_array_remove_index (selector->priv->sections, section);
 
-  if (destroy)
-    gtk_widget_destroy (destroy);
+  for (l = orphans; l; l = l->next)
+    wnck_selector_insert_window (selector, l->data);
+  g_list_free (orphans);
 
   wnck_selector_make_menu_consistent (selector);
 
-  gtk_menu_reposition (GTK_MENU (selector->priv->menu));
+  wnck_selector_menu_changed (selector);
 }
 
 static void
@@ -935,6 +1425,9 @@ wnck_selector_connect_to_window (WnckSelector *selector, WnckWindow *window)
   wncklet_connect_while_alive (window, "name_changed",
                                G_CALLBACK (wnck_selector_window_name_changed),
                                selector, selector);
+  wncklet_connect_while_alive (window, "class_changed",
+                               G_CALLBACK (wnck_selector_window_class_changed),
+                               selector, selector);
   wncklet_connect_while_alive (window, "state_changed",
                                G_CALLBACK (wnck_selector_window_state_changed),
                                selector, selector);
@@ -953,6 +1446,9 @@ wnck_selector_disconnect_from_window (WnckSelector *selector,
   g_signal_handlers_disconnect_by_func (window,
                                         wnck_selector_window_name_changed,
                                         selector);
+  g_signal_handlers_disconnect_by_func (window,
+                                        wnck_selector_window_class_changed,
+                                        selector);
   g_signal_handlers_disconnect_by_func (window,
                                         wnck_selector_window_state_changed,
                                         selector);
@@ -969,6 +1465,11 @@ wnck_selector_connect_to_screen (WnckSelector *selector, WnckScreen *screen)
                                (wnck_selector_active_window_changed),
                                selector, selector);
 
+  wncklet_connect_while_alive (screen, "active_workspace_changed",
+                               G_CALLBACK
+                               (wnck_selector_active_workspace_changed),
+                               selector, selector);
+
   wncklet_connect_while_alive (screen, "window_opened",
                                G_CALLBACK (wnck_selector_window_opened),
                                selector, selector);
@@ -993,6 +1494,9 @@ wnck_selector_disconnect_from_screen (WnckSelector *selector,
   g_signal_handlers_disconnect_by_func (screen,
                                         wnck_selector_active_window_changed,
                                         selector);
+  g_signal_handlers_disconnect_by_func (screen,
+                                        wnck_selector_active_workspace_changed,
+                                        selector);
   g_signal_handlers_disconnect_by_func (screen,
                                         wnck_selector_window_opened,
                                         selector);
@@ -1016,7 +1520,24 @@ wnck_selector_destroy_menu (GtkWidget *widget, WnckSelector *selector)
     g_hash_table_destroy (selector->priv->window_hash);
   selector->priv->window_hash = NULL;
 
+  g_array_set_size (selector->priv->sections, 0);
+  selector->priv->n_visible = 0;
+
+  selector->priv->separator = NULL;
   selector->priv->no_windows_item = NULL;
+  selector->priv->filter_item = NULL;
+
+  g_string_truncate (selector->priv->filter_text, 0);
+  g_free (selector->priv->filter);
+  selector->priv->filter = NULL;
+  g_ptr_array_set_size (selector->priv->filter_matches, 0);
+
+  if (selector->priv->update_idle != 0)
+    g_source_remove (selector->priv->update_idle);
+  selector->priv->update_idle = 0;
+
+  selector->priv->needs_rebuild = TRUE;
+  g_hash_table_remove_all (selector->priv->pending_windows);
 }
 
 static gboolean
@@ -1100,17 +1621,25 @@ static void
 wnck_selector_menu_hidden (GtkWidget *menu, WnckSelector *selector)
 {
   gtk_widget_set_state (GTK_WIDGET (selector), GTK_STATE_NORMAL);
+
+  wnck_selector_reset_filter (selector);
 }
 
 static void
 wnck_selector_on_show (GtkWidget *widget, WnckSelector *selector)
 {
-  GtkWidget *separator;
+  /* the menu is normally already built: only apply what has not been yet */
+  wnck_selector_flush_updates (selector);
+}
+
+static void
+wnck_selector_rebuild_menu (WnckSelector *selector)
+{
   WnckScreen *screen;
   WnckWorkspace *workspace;
   int nb_workspace;
   int i;
-  GList **windows_per_workspace;
+  GList **windows_per_section;
   GList *windows;
   GList *l, *children;
 
@@ -1120,16 +1649,35 @@ wnck_selector_on_show (GtkWidget *widget, WnckSelector *selector)
     gtk_container_remove (GTK_CONTAINER (selector->priv->menu), l->data);
   g_list_free (children);
 
+  selector->priv->separator = NULL;
+  selector->priv->no_windows_item = NULL;
+
+  g_string_truncate (selector->priv->filter_text, 0);
+  g_free (selector->priv->filter);
+  selector->priv->filter = NULL;
+  g_ptr_array_set_size (selector->priv->filter_matches, 0);
+
+  /* Shown with the text typed by the user */
+  selector->priv->filter_item = gtk_menu_item_new_with_label ("");
+  gtk_widget_set_sensitive (selector->priv->filter_item, FALSE);
+  gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu),
+                         selector->priv->filter_item);
+
   if (selector->priv->window_hash)
     g_hash_table_destroy (selector->priv->window_hash);
   selector->priv->window_hash = g_hash_table_new_full (g_direct_hash,
                                                  g_direct_equal,
-                                                 NULL, g_free);
+                                                 NULL, window_hash_item_free);
 
   screen = wnck_selector_get_screen (selector);
 
   nb_workspace = wnck_screen_get_workspace_count (screen);
-  windows_per_workspace = g_malloc0 (nb_workspace * sizeof (GList *));
+
+  g_array_set_size (selector->priv->sections, 0);
+  g_array_set_size (selector->priv->sections, nb_workspace + 1);
+  selector->priv->n_visible = 0;
+
+  windows_per_section = g_malloc0 ((nb_workspace + 1) * sizeof (GList *));
 
   /* Get windows ordered by workspaces */
   windows = wnck_screen_get_windows (screen);
@@ -1137,44 +1685,37 @@ wnck_selector_on_show (GtkWidget *widget, WnckSelector *selector)
 
   for (l = windows; l; l = l->next)
     {
-      workspace = wnck_window_get_workspace (l->data);
-      if (!workspace && wnck_window_is_pinned (l->data))
-        workspace = wnck_screen_get_active_workspace (screen);
-      if (!workspace)
+      i = wnck_selector_get_window_section (selector, l->data);
+      if (i < 0 || i > nb_workspace)
         continue;
-      i = wnck_workspace_get_number (workspace);
-      windows_per_workspace[i] = g_list_prepend (windows_per_workspace[i],
-                                                 l->data);
+      windows_per_section[i] = g_list_prepend (windows_per_section[i],
+                                               l->data);
     }
 
   /* Add windows from the current workspace */
-  workspace = wnck_screen_get_active_workspace (screen);
-  if (workspace)
-    {
-      i = wnck_workspace_get_number (workspace);
-
-      windows_per_workspace[i] = g_list_reverse (windows_per_workspace[i]);
-      for (l = windows_per_workspace[i]; l; l = l->next)
-        wnck_selector_append_window (selector, l->data);
-      g_list_free (windows_per_workspace[i]);
-      windows_per_workspace[i] = NULL;
-    }
+  i = WNCK_SELECTOR_CURRENT_SECTION;
+  windows_per_section[i] = g_list_reverse (windows_per_section[i]);
+  for (l = windows_per_section[i]; l; l = l->next)
+    wnck_selector_append_window (selector, l->data, i);
+  g_list_free (windows_per_section[i]);
 
   /* Add separator */
-  separator = gtk_separator_menu_item_new ();
-  gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu), separator);
+  selector->priv->separator = gtk_separator_menu_item_new ();
+  gtk_menu_shell_append (GTK_MENU_SHELL (selector->priv->menu),
+                         selector->priv->separator);
 
   /* Add windows from other workspaces */
-  for (i = 0; i < nb_workspace; i++)
+  for (i = 1; i <= nb_workspace; i++)
     {
-      wnck_selector_add_workspace (selector, screen, i);
-      windows_per_workspace[i] = g_list_reverse (windows_per_workspace[i]);
-      for (l = windows_per_workspace[i]; l; l = l->next)
-        wnck_selector_append_window (selector, l->data);
-      g_list_free (windows_per_workspace[i]);
-      windows_per_workspace[i] = NULL;
+      wnck_selector_get_section (selector, i)->header =
+        wnck_selector_add_workspace (selector, screen, i - 1, -1);
+
+      windows_per_section[i] = g_list_reverse (windows_per_section[i]);
+      for (l = windows_per_section[i]; l; l = l->next)
+        wnck_selector_append_window (selector, l->data, i);
+      g_list_free (windows_per_section[i]);
     }
-  g_free (windows_per_workspace);
+  g_free (windows_per_section);
 
   selector->priv->no_windows_item = wnck_selector_item_new (selector,
 		  					    _("No Windows Open"),
@@ -1209,6 +1750,8 @@ wnck_selector_fill (WnckSelector *selector)
                     G_CALLBACK (wnck_selector_destroy_menu), selector);
   g_signal_connect (selector->priv->menu, "show",
                     G_CALLBACK (wnck_selector_on_show), selector);
+  g_signal_connect (selector->priv->menu, "key-press-event",
+                    G_CALLBACK (wnck_selector_menu_key_press), selector);
 
   gtk_widget_set_name (GTK_WIDGET (selector),
                        "gnome-panel-window-menu-menu-bar");
@@ -1242,9 +1785,24 @@ wnck_selector_init (WnckSelector *selector)
   selector->priv->icon_window     = NULL;
 
   selector->priv->menu            = NULL;
+  selector->priv->separator       = NULL;
   selector->priv->no_windows_item = NULL;
   selector->priv->window_hash     = NULL;
 
+  selector->priv->sections        = g_array_new (FALSE, TRUE,
+                                                 sizeof (WnckSelectorSection));
+  selector->priv->n_visible       = 0;
+
+  selector->priv->update_idle     = 0;
+  selector->priv->needs_rebuild   = TRUE;
+  selector->priv->pending_windows = g_hash_table_new (g_direct_hash,
+                                                      g_direct_equal);
+
+  selector->priv->filter_item     = NULL;
+  selector->priv->filter_text     = g_string_new (NULL);
+  selector->priv->filter          = NULL;
+  selector->priv->filter_matches  = g_ptr_array_new ();
+
   selector->priv->size            = -1;
 }
 
@@ -1293,6 +1851,19 @@ wnck_selector_finalize (GObject *object)
     g_hash_table_destroy (selector->priv->window_hash);
   selector->priv->window_hash = NULL;
 
+  g_array_free (selector->priv->sections, TRUE);
+  selector->priv->sections = NULL;
+
+  g_hash_table_destroy (selector->priv->pending_windows);
+  selector->priv->pending_windows = NULL;
+
+  g_string_free (selector->priv->filter_text, TRUE);
+  selector->priv->filter_text = NULL;
+  g_free (selector->priv->filter);
+  selector->priv->filter = NULL;
+  g_ptr_array_free (selector->priv->filter_matches, TRUE);
+  selector->priv->filter_matches = NULL;
+
   G_OBJECT_CLASS (wnck_selector_parent_class)->finalize (object);
 }
 
@@ -1303,6 +1874,10 @@ wnck_selector_dispose (GObject *object)
 
   selector = WNCK_SELECTOR (object);
 
+  if (selector->priv->update_idle != 0)
+    g_source_remove (selector->priv->update_idle);
+  selector->priv->update_idle = 0;
+
   if (selector->priv->menu)
     gtk_widget_destroy (selector->priv->menu);
   selector->priv->menu = NULL;
@@ -1333,6 +1908,9 @@ wnck_selector_realize (GtkWidget *widget)
     wnck_selector_connect_to_window (selector, l->data);
 
   wnck_selector_connect_to_screen (selector, screen);
+
+  /* build the menu in the background, before the user needs it */
+  wnck_selector_queue_rebuild (selector);
 }
 
 static void
@@ -1350,6 +1928,14 @@ wnck_selector_unrealize (GtkWidget *widget)
   for (l = wnck_screen_get_windows (screen); l; l = l->next)
     wnck_selector_disconnect_from_window (selector, l->data);
 
+  /* we will not know about changes anymore */
+  if (selector->priv->update_idle != 0)
+    g_source_remove (selector->priv->update_idle);
+  selector->priv->update_idle = 0;
+
+  selector->priv->needs_rebuild = TRUE;
+  g_hash_table_remove_all (selector->priv->pending_windows);
+
   GTK_WIDGET_CLASS (wnck_selector_parent_class)->unrealize (widget);
 }
 
@@ -94,6 +94,8 @@ typedef struct _WnckTaskClass   WnckTaskClass;
 #define MINI_ICON_SIZE DEFAULT_MINI_ICON_WIDTH
 #define TASKLIST_BUTTON_PADDING 4
 #define TASKLIST_TEXT_MAX_WIDTH 25 /* maximum width in characters */
+/* narrowest button worth allocating when the tasklist is virtualized */
+#define TASKLIST_VIRTUAL_MIN_WIDTH (MINI_ICON_SIZE + 4 * TASKLIST_BUTTON_PADDING)
 
 #define N_SCREEN_CONNECTIONS 5
 
@@ -147,6 +149,7 @@ struct _WnckTask
                               * to change the togglebutton state
                               */
   guint was_active : 1;      /* used to fixup activation behavior */
+  guint overflowed : 1;      /* not allocated, listed in the overflow menu */
 
   guint button_activate;
 
@@ -198,6 +201,15 @@ struct _WnckTasklistPrivate
   GHashTable *class_group_hash;
   GHashTable *win_hash;
 
+  /* Workspace membership index of all windows of the screen, so that we
+   * only need to look at the affected windows when a window changes
+   * workspace or when the active workspace changes. Workspaces are
+   * identified by their number + 1, 0 meaning no workspace (pinned).
+   */
+  GHashTable *workspace_windows; /* workspace -> GList of WnckWindow */
+  GHashTable *window_workspaces; /* WnckWindow -> workspace */
+  int active_workspace;
+
   gint max_button_width;
   gint max_button_height;
 
@@ -228,6 +240,16 @@ struct _WnckTasklistPrivate
   GtkReliefStyle relief;
 
   guint drag_start_time;
+
+  /* Virtualized mode: only the tasks fitting in the allocation get a
+   * button allocated, the others are reachable from the overflow button.
+   */
+  gboolean virtualized;
+  int first_virtual_task;
+  GList *overflow_tasks;
+  int overflow_count;
+  GtkWidget *overflow_button;
+  GtkWidget *overflow_menu;
 };
 
 static GType wnck_task_get_type (void);
@@ -335,6 +357,8 @@ static void     wnck_tasklist_change_active_task       (WnckTasklist *tasklist,
 static gboolean wnck_tasklist_change_active_timeout    (gpointer data);
 static void     wnck_tasklist_activate_task_window     (WnckTask *task,
                                                         guint32   timestamp);
+static void     wnck_tasklist_overflow_clicked         (GtkButton    *button,
+                                                        WnckTasklist *tasklist);
 
 static void     wnck_tasklist_update_icon_geometries   (WnckTasklist *tasklist,
 							GList        *visible_tasks);
@@ -393,6 +417,8 @@ wnck_task_init (WnckTask *task)
 
   task->was_active = FALSE;
 
+  task->overflowed = FALSE;
+
   task->button_activate = 0;
 
   task->dnd_timestamp = 0;
@@ -637,6 +663,10 @@ wnck_tasklist_init (WnckTasklist *tasklist)
   tasklist->priv->class_group_hash = g_hash_table_new (NULL, NULL);
   tasklist->priv->win_hash = g_hash_table_new (NULL, NULL);
 
+  tasklist->priv->workspace_windows = g_hash_table_new (NULL, NULL);
+  tasklist->priv->window_workspaces = g_hash_table_new (NULL, NULL);
+  tasklist->priv->active_workspace = 0;
+
   tasklist->priv->max_button_width = 0;
   tasklist->priv->max_button_height = 0;
 
@@ -669,6 +699,23 @@ wnck_tasklist_init (WnckTasklist *tasklist)
 
   tasklist->priv->drag_start_time = 0;
 
+  tasklist->priv->virtualized = FALSE;
+  tasklist->priv->first_virtual_task = 0;
+  tasklist->priv->overflow_tasks = NULL;
+  tasklist->priv->overflow_count = 0;
+  tasklist->priv->overflow_menu = NULL;
+
+  tasklist->priv->overflow_button = gtk_button_new_with_label ("");
+  gtk_widget_set_tooltip_text (tasklist->priv->overflow_button,
+                               _("Show the windows that do not fit in the window list"));
+  g_signal_connect_object (G_OBJECT (tasklist->priv->overflow_button), "clicked",
+                           G_CALLBACK (wnck_tasklist_overflow_clicked),
+                           G_OBJECT (tasklist),
+                           0);
+  gtk_widget_set_parent (tasklist->priv->overflow_button, widget);
+  gtk_widget_set_child_visible (tasklist->priv->overflow_button, FALSE);
+  gtk_widget_show (tasklist->priv->overflow_button);
+
   atk_obj = gtk_widget_get_accessible (widget);
   atk_object_set_name (atk_obj, _("Window List"));
   atk_object_set_description (atk_obj, _("Tool to switch between visible windows"));
@@ -762,6 +809,14 @@ wnck_tasklist_class_init (WnckTasklistClass *klass)
                                                               G_PARAM_READABLE|G_PARAM_STATIC_NAME|G_PARAM_STATIC_NICK|G_PARAM_STATIC_BLURB));
 }
 
+static void
+wnck_tasklist_free_skipped_window (skipped_window *skipped)
+{
+  g_signal_handler_disconnect (skipped->window, skipped->tag);
+  g_object_unref (skipped->window);
+  g_free (skipped);
+}
+
 static void
 wnck_tasklist_free_skipped_windows (WnckTasklist  *tasklist)
 {
@@ -771,16 +826,50 @@ wnck_tasklist_free_skipped_windows (WnckTasklist  *tasklist)
 
   while (l != NULL)
     {
-      skipped_window *skipped = (skipped_window*) l->data;
-      g_signal_handler_disconnect (skipped->window, skipped->tag);
-      g_object_unref (skipped->window);
-      g_free (skipped);
+      wnck_tasklist_free_skipped_window ((skipped_window*) l->data);
       l = l->next;
     }
 
   g_list_free (tasklist->priv->skipped_windows);
 }
 
+/* Watches the state of a window that is not shown, so that it can be added
+ * back when it needs attention */
+static void
+wnck_tasklist_add_skipped_window (WnckTasklist *tasklist,
+                                  WnckWindow   *win)
+{
+  skipped_window *skipped = g_new0 (skipped_window, 1);
+  skipped->window = g_object_ref (win);
+  skipped->tag = g_signal_connect (G_OBJECT (win),
+                                   "state_changed",
+                                   G_CALLBACK (wnck_task_state_changed),
+                                   tasklist);
+  tasklist->priv->skipped_windows =
+    g_list_prepend (tasklist->priv->skipped_windows,
+                    (gpointer) skipped);
+}
+
+static void
+wnck_tasklist_remove_skipped_window (WnckTasklist *tasklist,
+                                     WnckWindow   *win)
+{
+  GList *l;
+
+  for (l = tasklist->priv->skipped_windows; l != NULL; l = l->next)
+    {
+      skipped_window *skipped = (skipped_window*) l->data;
+
+      if (skipped->window == win)
+        {
+          wnck_tasklist_free_skipped_window (skipped);
+          tasklist->priv->skipped_windows =
+            g_list_delete_link (tasklist->priv->skipped_windows, l);
+          return;
+        }
+    }
+}
+
 static void
 wnck_tasklist_finalize (GObject *object)
 {
@@ -809,6 +898,13 @@ wnck_tasklist_finalize (GObject *object)
   g_hash_table_destroy (tasklist->priv->win_hash);
   tasklist->priv->win_hash = NULL;
 
+  /* The index is emptied when disconnecting from the screen */
+  g_hash_table_destroy (tasklist->priv->workspace_windows);
+  tasklist->priv->workspace_windows = NULL;
+
+  g_hash_table_destroy (tasklist->priv->window_workspaces);
+  tasklist->priv->window_workspaces = NULL;
+
   if (tasklist->priv->activate_timeout_id != 0)
     {
       g_source_remove (tasklist->priv->activate_timeout_id);
@@ -825,6 +921,16 @@ wnck_tasklist_finalize (GObject *object)
   tasklist->priv->size_hints = NULL;
   tasklist->priv->size_hints_len = 0;
 
+  g_list_free (tasklist->priv->overflow_tasks);
+  tasklist->priv->overflow_tasks = NULL;
+
+  if (tasklist->priv->overflow_menu)
+    {
+      gtk_widget_destroy (tasklist->priv->overflow_menu);
+      g_object_unref (tasklist->priv->overflow_menu);
+      tasklist->priv->overflow_menu = NULL;
+    }
+
   if (tasklist->priv->free_icon_loader_data != NULL)
     (* tasklist->priv->free_icon_loader_data) (tasklist->priv->icon_loader_data);
   tasklist->priv->free_icon_loader_data = NULL;
@@ -945,6 +1051,42 @@ wnck_tasklist_set_include_all_workspaces (WnckTasklist *tasklist,
   gtk_widget_queue_resize (GTK_WIDGET (tasklist));
 }
 
+/**
+ * wnck_tasklist_set_virtualized:
+ * @tasklist: a #WnckTasklist.
+ * @virtualized: whether to only allocate buttons for the #WnckWindow that fit
+ * in @tasklist.
+ *
+ * Sets @tasklist to virtualize its buttons or not, according to
+ * @virtualized. When virtualized, @tasklist never shrinks buttons to a width
+ * where they cannot show their icon anymore: the buttons that do not fit in
+ * the allocation of @tasklist are not allocated nor drawn, and the
+ * corresponding #WnckWindow are listed in a menu available from an overflow
+ * button instead. Activating a #WnckWindow that is not shown, for example by
+ * scrolling on @tasklist, scrolls its button into view.
+ *
+ * This keeps the cost of allocating and drawing @tasklist bounded by the
+ * number of buttons that are actually visible, which matters when there are
+ * hundreds of #WnckWindow.
+ *
+ * Since: 3.4
+ */
+void
+wnck_tasklist_set_virtualized (WnckTasklist *tasklist,
+                               gboolean      virtualized)
+{
+  g_return_if_fail (WNCK_IS_TASKLIST (tasklist));
+
+  virtualized = (virtualized != 0);
+
+  if (tasklist->priv->virtualized == virtualized)
+    return;
+
+  tasklist->priv->virtualized = virtualized;
+  tasklist->priv->first_virtual_task = 0;
+  gtk_widget_queue_resize (GTK_WIDGET (tasklist));
+}
+
 /**
  * wnck_tasklist_set_grouping_limit:
  * @tasklist: a #WnckTasklist.
@@ -1396,11 +1538,80 @@ wnck_task_size_allocated (GtkWidget     *widget,
   }
 }
 
+static void
+wnck_tasklist_allocate_slot (GtkWidget     *widget,
+                             GtkAllocation *allocation,
+                             int            total_width,
+                             int            n_rows,
+                             int            n_cols,
+                             int            slot,
+                             GtkWidget     *button)
+{
+  GtkAllocation child_allocation;
+  int row = slot % n_rows;
+  int col = slot / n_rows;
+
+  if (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL)
+    col = n_cols - col - 1;
+
+  child_allocation.x = total_width*col / n_cols;
+  child_allocation.y = allocation->height*row / n_rows;
+  child_allocation.width = total_width*(col + 1) / n_cols - child_allocation.x;
+  child_allocation.height = allocation->height*(row + 1) / n_rows - child_allocation.y;
+  child_allocation.x += allocation->x;
+  child_allocation.y += allocation->y;
+
+  gtk_widget_size_allocate (button, &child_allocation);
+}
+
+static void
+wnck_tasklist_clear_overflow (WnckTasklist *tasklist)
+{
+  GList *l;
+
+#define CLEAR_OVERFLOWED(list)                  \
+  for (l = list; l != NULL; l = l->next)        \
+    WNCK_TASK (l->data)->overflowed = FALSE;
+
+  CLEAR_OVERFLOWED (tasklist->priv->windows)
+  CLEAR_OVERFLOWED (tasklist->priv->class_groups)
+  CLEAR_OVERFLOWED (tasklist->priv->startup_sequences)
+
+#undef CLEAR_OVERFLOWED
+
+  g_list_free (tasklist->priv->overflow_tasks);
+  tasklist->priv->overflow_tasks = NULL;
+}
+
+/* Sets the number of tasks listed by the overflow button, and returns the
+ * width the button asks for with that label */
+static int
+wnck_tasklist_set_overflow_count (WnckTasklist *tasklist,
+                                  int           count)
+{
+  GtkRequisition requisition;
+
+  if (tasklist->priv->overflow_count != count)
+    {
+      char *text;
+
+      tasklist->priv->overflow_count = count;
+      text = g_strdup_printf ("+%d", count);
+      gtk_button_set_label (GTK_BUTTON (tasklist->priv->overflow_button),
+                            text);
+      g_free (text);
+    }
+
+  gtk_widget_get_preferred_size (tasklist->priv->overflow_button,
+                                 NULL, &requisition);
+
+  return requisition.width;
+}
+
 static void
 wnck_tasklist_size_allocate (GtkWidget      *widget,
                              GtkAllocation  *allocation)
 {
-  GtkAllocation child_allocation;
   WnckTasklist *tasklist;
   WnckTask *class_group_task;
   int n_windows;
@@ -1418,6 +1629,13 @@ wnck_tasklist_size_allocate (GtkWidget      *widget,
   GList *visible_tasks = NULL;
   GList *windows_sorted = NULL;
   int grouping_limit;
+  int n_visible;
+  int n_shown;
+  int first_shown;
+  int n_logical_cols;
+  int overflow_width;
+  GtkAllocation task_allocation;
+  gboolean rtl;
 
   tasklist = WNCK_TASKLIST (widget);
 
@@ -1514,6 +1732,72 @@ wnck_tasklist_size_allocate (GtkWidget      *widget,
   /* Sort */
   visible_tasks = g_list_sort (visible_tasks, wnck_task_compare);
 
+  /* Virtualize: only allocate the buttons that fit */
+  n_visible = g_list_length (visible_tasks);
+  n_shown = n_visible;
+  first_shown = 0;
+  n_logical_cols = n_cols;
+  overflow_width = 0;
+
+  wnck_tasklist_clear_overflow (tasklist);
+
+  if (tasklist->priv->virtualized && tasklist->priv->overflow_button &&
+      n_cols > 0 && allocation->width / n_cols < TASKLIST_VIRTUAL_MIN_WIDTH)
+    {
+      int max_cols;
+
+      max_cols = MAX (allocation->width / TASKLIST_VIRTUAL_MIN_WIDTH, 1);
+
+      if (n_visible > max_cols * n_rows)
+        {
+          int active_index = -1;
+          int needed_width;
+
+          /* The overflow button gets the width it asks for at the end of
+           * the tasklist, and the buttons share the rest. Its width depends
+           * on the number of tasks it lists, so start with the label of the
+           * last allocation and measure again if the count changes. */
+          overflow_width =
+            wnck_tasklist_set_overflow_count (tasklist,
+                                              MAX (tasklist->priv->overflow_count, 1));
+          overflow_width = MIN (overflow_width, allocation->width / 2);
+
+          n_cols = MAX ((allocation->width - overflow_width) / TASKLIST_VIRTUAL_MIN_WIDTH, 1);
+          n_shown = n_cols * n_rows;
+
+          needed_width =
+            wnck_tasklist_set_overflow_count (tasklist, n_visible - n_shown);
+          needed_width = MIN (needed_width, allocation->width / 2);
+
+          if (needed_width > overflow_width)
+            {
+              overflow_width = needed_width;
+              n_cols = MAX ((allocation->width - overflow_width) / TASKLIST_VIRTUAL_MIN_WIDTH, 1);
+              n_shown = n_cols * n_rows;
+              wnck_tasklist_set_overflow_count (tasklist, n_visible - n_shown);
+            }
+
+          if (tasklist->priv->active_task)
+            active_index = g_list_index (visible_tasks,
+                                         tasklist->priv->active_task);
+          if (active_index < 0 && tasklist->priv->active_class_group)
+            active_index = g_list_index (visible_tasks,
+                                         tasklist->priv->active_class_group);
+
+          /* Keep the previous window of buttons, unless the active task
+           * needs to be scrolled into view */
+          first_shown = tasklist->priv->first_virtual_task;
+          if (active_index >= 0 && active_index < first_shown)
+            first_shown = active_index;
+          else if (active_index >= first_shown + n_shown)
+            first_shown = active_index - n_shown + 1;
+
+          first_shown = CLAMP (first_shown, 0, n_visible - n_shown);
+        }
+    }
+
+  tasklist->priv->first_virtual_task = first_shown;
+
   /* Allocate children */
   l = visible_tasks;
   i = 0;
@@ -1523,24 +1807,39 @@ wnck_tasklist_size_allocate (GtkWidget      *widget,
    * panel allocated to us won't have the panel popup menu, but the tasklist
    * popup menu */
   total_width = allocation->width;
+  rtl = (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL);
+
+  /* the buttons share what the overflow button leaves */
+  task_allocation = *allocation;
+  task_allocation.width -= overflow_width;
+  if (rtl)
+    task_allocation.x += overflow_width;
+  total_width -= overflow_width;
   while (l != NULL)
     {
       WnckTask *task = WNCK_TASK (l->data);
+      /* row and col are the logical position, used for scrolling; they only
+       * differ from the allocated slot when virtualized */
       int row = i % n_rows;
       int col = i / n_rows;
+      int slot = i - first_shown;
 
-      if (gtk_widget_get_direction (widget) == GTK_TEXT_DIR_RTL)
-        col = n_cols - col - 1;
-
-      child_allocation.x = total_width*col / n_cols;
-      child_allocation.y = allocation->height*row / n_rows;
-      child_allocation.width = total_width*(col + 1) / n_cols - child_allocation.x;
-      child_allocation.height = allocation->height*(row + 1) / n_rows - child_allocation.y;
-      child_allocation.x += allocation->x;
-      child_allocation.y += allocation->y;
+      if (rtl)
+        col = n_logical_cols - col - 1;
 
-      gtk_widget_size_allocate (task->button, &child_allocation);
-      gtk_widget_set_child_visible (GTK_WIDGET (task->button), TRUE);
+      if (slot >= 0 && slot < n_shown)
+        {
+          wnck_tasklist_allocate_slot (widget, &task_allocation, total_width,
+                                       n_rows, n_cols, slot, task->button);
+          gtk_widget_set_child_visible (GTK_WIDGET (task->button), TRUE);
+        }
+      else
+        {
+          gtk_widget_set_child_visible (GTK_WIDGET (task->button), FALSE);
+          task->overflowed = TRUE;
+          tasklist->priv->overflow_tasks =
+            g_list_prepend (tasklist->priv->overflow_tasks, task);
+        }
 
       if (task->type != WNCK_TASK_STARTUP_SEQUENCE)
         {
@@ -1564,6 +1863,27 @@ wnck_tasklist_size_allocate (GtkWidget      *widget,
       l = l->next;
     }
 
+  tasklist->priv->overflow_tasks =
+    g_list_reverse (tasklist->priv->overflow_tasks);
+
+  if (n_shown < n_visible && tasklist->priv->overflow_button)
+    {
+      GtkAllocation child_allocation;
+
+      child_allocation.x = allocation->x;
+      if (!rtl)
+        child_allocation.x += allocation->width - overflow_width;
+      child_allocation.y = allocation->y;
+      child_allocation.width = overflow_width;
+      child_allocation.height = allocation->height;
+
+      gtk_widget_size_allocate (tasklist->priv->overflow_button,
+                                &child_allocation);
+      gtk_widget_set_child_visible (tasklist->priv->overflow_button, TRUE);
+    }
+  else if (tasklist->priv->overflow_button)
+    gtk_widget_set_child_visible (tasklist->priv->overflow_button, FALSE);
+
   /* Update icon geometries. */
   wnck_tasklist_update_icon_geometries (tasklist, visible_tasks);
 
@@ -1669,6 +1989,9 @@ wnck_tasklist_forall (GtkContainer *container,
 
       (* callback) (task->button, callback_data);
     }
+
+  if (include_internals && tasklist->priv->overflow_button)
+    (* callback) (tasklist->priv->overflow_button, callback_data);
 }
 
 static void
@@ -1713,6 +2036,9 @@ wnck_tasklist_remove (GtkContainer   *container,
 	  tasklist->priv->windows =
 	    g_list_remove (tasklist->priv->windows,
 			   task);
+	  tasklist->priv->overflow_tasks =
+	    g_list_remove (tasklist->priv->overflow_tasks,
+			   task);
 
           gtk_widget_unparent (widget);
           g_object_unref (task);
@@ -1733,6 +2059,9 @@ wnck_tasklist_remove (GtkContainer   *container,
 	  tasklist->priv->class_groups =
 	    g_list_remove (tasklist->priv->class_groups,
 			   task);
+	  tasklist->priv->overflow_tasks =
+	    g_list_remove (tasklist->priv->overflow_tasks,
+			   task);
 
           gtk_widget_unparent (widget);
           g_object_unref (task);
@@ -1751,6 +2080,9 @@ wnck_tasklist_remove (GtkContainer   *container,
 	  tasklist->priv->startup_sequences =
 	    g_list_remove (tasklist->priv->startup_sequences,
 			   task);
+	  tasklist->priv->overflow_tasks =
+	    g_list_remove (tasklist->priv->overflow_tasks,
+			   task);
 
           gtk_widget_unparent (widget);
           g_object_unref (task);
@@ -1758,6 +2090,12 @@ wnck_tasklist_remove (GtkContainer   *container,
 	}
     }
 
+  if (widget == tasklist->priv->overflow_button)
+    {
+      gtk_widget_unparent (widget);
+      tasklist->priv->overflow_button = NULL;
+    }
+
   gtk_widget_queue_resize (GTK_WIDGET (container));
 }
 
@@ -2099,15 +2437,204 @@ wnck_tasklist_include_window (WnckTasklist *tasklist, WnckWindow *win)
                                        FALSE /* check_for_skipped_list */);
 }
 
+/* Creates the task for @win, and adds it to its class group task. Returns
+ * the class group task, if any. */
+static WnckTask *
+wnck_tasklist_add_window_task (WnckTasklist *tasklist,
+                               WnckWindow   *win)
+{
+  WnckClassGroup *class_group;
+  WnckTask *win_task;
+  WnckTask *class_group_task;
+
+  win_task = wnck_task_new_from_window (tasklist, win);
+  tasklist->priv->windows = g_list_prepend (tasklist->priv->windows, win_task);
+  g_hash_table_insert (tasklist->priv->win_hash, win, win_task);
+
+  gtk_widget_set_parent (win_task->button, GTK_WIDGET (tasklist));
+  gtk_widget_show (win_task->button);
+
+  /* Class group */
+
+  class_group = wnck_window_get_class_group (win);
+  /* don't group windows if they do not belong to any class */
+  if (strcmp (wnck_class_group_get_id (class_group), "") != 0)
+    {
+      class_group_task =
+                g_hash_table_lookup (tasklist->priv->class_group_hash,
+                                     class_group);
+
+      if (class_group_task == NULL)
+        {
+          class_group_task =
+                          wnck_task_new_from_class_group (tasklist,
+                                                          class_group);
+          gtk_widget_set_parent (class_group_task->button,
+                                 GTK_WIDGET (tasklist));
+          gtk_widget_show (class_group_task->button);
+
+          tasklist->priv->class_groups =
+                          g_list_prepend (tasklist->priv->class_groups,
+                                          class_group_task);
+          g_hash_table_insert (tasklist->priv->class_group_hash,
+                               class_group, class_group_task);
+        }
+
+      class_group_task->windows =
+                            g_list_prepend (class_group_task->windows,
+                                            win_task);
+    }
+  else
+    {
+      class_group_task = NULL;
+
+      g_object_ref (win_task);
+      tasklist->priv->windows_without_class_group =
+                      g_list_prepend (tasklist->priv->windows_without_class_group,
+                                      win_task);
+    }
+
+  return class_group_task;
+}
+
+/* Destroys the task for a window, and removes it from its class group
+ * task; the class group task goes away with its last window. */
+static void
+wnck_tasklist_remove_window_task (WnckTasklist *tasklist,
+                                  WnckTask     *win_task)
+{
+  WnckTask *class_group_task;
+
+  class_group_task = g_hash_table_lookup (tasklist->priv->class_group_hash,
+                                          win_task->class_group);
+
+  if (class_group_task)
+    {
+      class_group_task->windows = g_list_remove (class_group_task->windows,
+                                                 win_task);
+
+      if (class_group_task->windows == NULL)
+        {
+          if (tasklist->priv->active_class_group == class_group_task)
+            tasklist->priv->active_class_group = NULL;
+
+          /* removes task from list as a side effect */
+          gtk_widget_destroy (class_group_task->button);
+        }
+      else
+        wnck_task_update_visible_state (class_group_task);
+    }
+
+  /* removes task from list as a side effect */
+  gtk_widget_destroy (win_task->button);
+}
+
+/* Adds or removes the task for @window if the window should now be shown or
+ * hidden, keeping the skipped windows in sync like
+ * wnck_tasklist_update_lists() does. Returns whether something changed. */
+static gboolean
+wnck_tasklist_update_window_task (WnckTasklist *tasklist,
+                                  WnckWindow   *window)
+{
+  WnckTask *win_task;
+  WnckTask *class_group_task;
+  gboolean  show;
+
+  win_task = g_hash_table_lookup (tasklist->priv->win_hash, window);
+  show = wnck_tasklist_include_window (tasklist, window);
+
+  if (show && win_task == NULL)
+    {
+      wnck_tasklist_remove_skipped_window (tasklist, window);
+
+      /* this also ends the matching startup sequences */
+      class_group_task = wnck_tasklist_add_window_task (tasklist, window);
+
+      if (class_group_task)
+        {
+          class_group_task->windows = g_list_sort (class_group_task->windows,
+                                                   wnck_task_compare);
+          wnck_task_update_visible_state (class_group_task);
+        }
+
+      return TRUE;
+    }
+  else if (!show && win_task != NULL)
+    {
+      wnck_tasklist_remove_window_task (tasklist, win_task);
+
+      if (tasklist_include_in_skipped_list (tasklist, window))
+        wnck_tasklist_add_skipped_window (tasklist, window);
+
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static int
+wnck_tasklist_get_window_workspace (WnckWindow *window)
+{
+  WnckWorkspace *workspace;
+
+  workspace = wnck_window_get_workspace (window);
+
+  return workspace ? wnck_workspace_get_number (workspace) + 1 : 0;
+}
+
+static void
+wnck_tasklist_index_add_window (WnckTasklist *tasklist,
+                                WnckWindow   *window)
+{
+  int    workspace;
+  GList *members;
+
+  workspace = wnck_tasklist_get_window_workspace (window);
+
+  g_hash_table_insert (tasklist->priv->window_workspaces,
+                       window, GINT_TO_POINTER (workspace));
+
+  if (workspace == 0)
+    return;
+
+  members = g_hash_table_lookup (tasklist->priv->workspace_windows,
+                                 GINT_TO_POINTER (workspace));
+  members = g_list_prepend (members, window);
+  g_hash_table_insert (tasklist->priv->workspace_windows,
+                       GINT_TO_POINTER (workspace), members);
+}
+
+static void
+wnck_tasklist_index_remove_window (WnckTasklist *tasklist,
+                                   WnckWindow   *window)
+{
+  gpointer  workspace;
+  GList    *members;
+
+  workspace = g_hash_table_lookup (tasklist->priv->window_workspaces, window);
+  g_hash_table_remove (tasklist->priv->window_workspaces, window);
+
+  if (workspace == NULL)
+    return;
+
+  members = g_hash_table_lookup (tasklist->priv->workspace_windows, workspace);
+  members = g_list_remove (members, window);
+
+  if (members)
+    g_hash_table_insert (tasklist->priv->workspace_windows,
+                         workspace, members);
+  else
+    g_hash_table_remove (tasklist->priv->workspace_windows, workspace);
+}
+
 static void
 wnck_tasklist_update_lists (WnckTasklist *tasklist)
 {
   GdkWindow *tasklist_window;
   GList *windows;
   WnckWindow *win;
-  WnckClassGroup *class_group;
+  WnckWorkspace *active_workspace;
   GList *l;
-  WnckTask *win_task;
   WnckTask *class_group_task;
 
   wnck_tasklist_free_tasks (tasklist);
@@ -2144,70 +2671,19 @@ wnck_tasklist_update_lists (WnckTasklist *tasklist)
 	}
     }
 
+  active_workspace = wnck_screen_get_active_workspace (tasklist->priv->screen);
+  tasklist->priv->active_workspace =
+    active_workspace ? wnck_workspace_get_number (active_workspace) + 1 : 0;
+
   l = windows = wnck_screen_get_windows (tasklist->priv->screen);
   while (l != NULL)
     {
       win = WNCK_WINDOW (l->data);
 
       if (wnck_tasklist_include_window (tasklist, win))
-	{
-	  win_task = wnck_task_new_from_window (tasklist, win);
-	  tasklist->priv->windows = g_list_prepend (tasklist->priv->windows, win_task);
-	  g_hash_table_insert (tasklist->priv->win_hash, win, win_task);
-
-	  gtk_widget_set_parent (win_task->button, GTK_WIDGET (tasklist));
-	  gtk_widget_show (win_task->button);
-
-	  /* Class group */
-
-	  class_group = wnck_window_get_class_group (win);
-          /* don't group windows if they do not belong to any class */
-          if (strcmp (wnck_class_group_get_id (class_group), "") != 0)
-            {
-              class_group_task =
-                        g_hash_table_lookup (tasklist->priv->class_group_hash,
-                                             class_group);
-
-              if (class_group_task == NULL)
-                {
-                  class_group_task =
-                                  wnck_task_new_from_class_group (tasklist,
-                                                                  class_group);
-                  gtk_widget_set_parent (class_group_task->button,
-                                         GTK_WIDGET (tasklist));
-                  gtk_widget_show (class_group_task->button);
-
-                  tasklist->priv->class_groups =
-                                  g_list_prepend (tasklist->priv->class_groups,
-                                                  class_group_task);
-                  g_hash_table_insert (tasklist->priv->class_group_hash,
-                                       class_group, class_group_task);
-                }
-
-              class_group_task->windows =
-                                    g_list_prepend (class_group_task->windows,
-                                                    win_task);
-            }
-          else
-            {
-              g_object_ref (win_task);
-              tasklist->priv->windows_without_class_group =
-                              g_list_prepend (tasklist->priv->windows_without_class_group,
-                                              win_task);
-            }
-	}
+        wnck_tasklist_add_window_task (tasklist, win);
       else if (tasklist_include_in_skipped_list (tasklist, win))
-        {
-          skipped_window *skipped = g_new0 (skipped_window, 1);
-          skipped->window = g_object_ref (win);
-          skipped->tag = g_signal_connect (G_OBJECT (win),
-                                           "state_changed",
-                                           G_CALLBACK (wnck_task_state_changed),
-                                           tasklist);
-          tasklist->priv->skipped_windows =
-            g_list_prepend (tasklist->priv->skipped_windows,
-                            (gpointer) skipped);
-        }
+        wnck_tasklist_add_skipped_window (tasklist, win);
 
       l = l->next;
     }
@@ -2289,6 +2765,14 @@ wnck_tasklist_change_active_task (WnckTasklist *tasklist, WnckTask *active_task)
 	  tasklist->priv->active_class_group->really_toggling = FALSE;
 	}
     }
+
+  /* Bring the newly active task into view */
+  if (tasklist->priv->virtualized &&
+      ((tasklist->priv->active_task &&
+        tasklist->priv->active_task->overflowed) ||
+       (tasklist->priv->active_class_group &&
+        tasklist->priv->active_class_group->overflowed)))
+    gtk_widget_queue_resize (GTK_WIDGET (tasklist));
 }
 
 static void
@@ -2296,13 +2780,28 @@ wnck_tasklist_update_icon_geometries (WnckTasklist *tasklist,
 				      GList        *visible_tasks)
 {
 	gint x, y, width, height;
+	gint origin_x, origin_y;
+	GdkWindow *origin_window;
 	GList *l1;
 
+	/* All buttons share the same parent window, so only look its origin
+	 * up once instead of doing a round trip per button. */
+	origin_window = NULL;
+	origin_x = origin_y = 0;
+
 	for (l1 = visible_tasks; l1; l1 = l1->next) {
 		WnckTask *task = WNCK_TASK (l1->data);
+                GtkWidget *button;
                 GtkAllocation allocation;
 
-		if (!gtk_widget_get_realized (task->button))
+                /* Windows that are not shown minimize to the overflow
+                 * button. */
+                if (task->overflowed)
+                  button = tasklist->priv->overflow_button;
+                else
+                  button = task->button;
+
+		if (button == NULL || !gtk_widget_get_realized (button))
 			continue;
 
                 /* Let's cheat with some internal knowledge of GtkButton: in a
@@ -2310,13 +2809,16 @@ wnck_tasklist_update_icon_geometries (WnckTasklist *tasklist,
                  * to know the position of the widget, we should use the
                  * the position of the parent window and the allocation information. */
 
-                gtk_widget_get_allocation (task->button, &allocation);
+                gtk_widget_get_allocation (button, &allocation);
 
-                gdk_window_get_origin (gtk_widget_get_parent_window (task->button),
-                                       &x, &y);
+                if (gtk_widget_get_parent_window (button) != origin_window) {
+                        origin_window = gtk_widget_get_parent_window (button);
+                        gdk_window_get_origin (origin_window,
+                                               &origin_x, &origin_y);
+                }
 
-                x += allocation.x;
-                y += allocation.y;
+                x = origin_x + allocation.x;
+                y = origin_y + allocation.y;
                 width = allocation.width;
                 height = allocation.height;
 
@@ -2336,6 +2838,11 @@ wnck_tasklist_update_icon_geometries (WnckTasklist *tasklist,
 			}
 		}
 	}
+
+	/* wnck_window_set_icon_geometry() only sends changed geometries and
+	 * does not sync: push them all to the server at once. */
+	if (gtk_widget_get_realized (GTK_WIDGET (tasklist)))
+		gdk_display_flush (gtk_widget_get_display (GTK_WIDGET (tasklist)));
 }
 
 static void
@@ -2368,45 +2875,64 @@ wnck_tasklist_active_workspace_changed (WnckScreen    *screen,
                                         WnckWorkspace *previous_workspace,
 					WnckTasklist  *tasklist)
 {
-  wnck_tasklist_update_lists (tasklist);
-  gtk_widget_queue_resize (GTK_WIDGET (tasklist));
-}
-
-static void
-wnck_tasklist_window_changed_workspace (WnckWindow   *window,
-					WnckTasklist *tasklist)
-{
-  WnckWorkspace *active_ws;
-  WnckWorkspace *window_ws;
-  gboolean       need_update;
+  WnckWorkspace *active_workspace;
+  int            old_workspace;
+  int            new_workspace;
+  GList         *windows;
   GList         *l;
+  gboolean       changed;
 
-  active_ws = wnck_screen_get_active_workspace (tasklist->priv->screen);
-  window_ws = wnck_window_get_workspace (window);
+  active_workspace = wnck_screen_get_active_workspace (screen);
 
-  if (!window_ws)
-    return;
+  old_workspace = tasklist->priv->active_workspace;
+  new_workspace =
+    active_workspace ? wnck_workspace_get_number (active_workspace) + 1 : 0;
+  tasklist->priv->active_workspace = new_workspace;
 
-  need_update = FALSE;
+  /* Without an active workspace, all windows are shown */
+  if (old_workspace == 0 || new_workspace == 0)
+    {
+      wnck_tasklist_update_lists (tasklist);
+      gtk_widget_queue_resize (GTK_WIDGET (tasklist));
+      return;
+    }
 
-  if (active_ws == window_ws)
-    need_update = TRUE;
+  if (tasklist->priv->include_all_workspaces || old_workspace == new_workspace)
+    return;
 
-  l = tasklist->priv->windows;
-  while (!need_update && l != NULL)
-    {
-      WnckTask *task = l->data;
+  /* Only the windows from the previous and the new active workspaces can be
+   * shown or hidden by the switch; pinned windows are always shown. */
+  windows = g_list_copy (g_hash_table_lookup (tasklist->priv->workspace_windows,
+                                              GINT_TO_POINTER (old_workspace)));
+  windows = g_list_concat (windows,
+                           g_list_copy (g_hash_table_lookup (tasklist->priv->workspace_windows,
+                                                             GINT_TO_POINTER (new_workspace))));
 
-      if (task->type == WNCK_TASK_WINDOW &&
-          task->window == window)
-        need_update = TRUE;
+  changed = FALSE;
+  for (l = windows; l != NULL; l = l->next)
+    changed |= wnck_tasklist_update_window_task (tasklist, l->data);
 
-      l = l->next;
+  g_list_free (windows);
+
+  if (changed)
+    {
+      /* the active window might have been added or removed */
+      wnck_tasklist_active_window_changed (screen, NULL, tasklist);
+      gtk_widget_queue_resize (GTK_WIDGET (tasklist));
     }
+}
 
-  if (need_update)
+static void
+wnck_tasklist_window_changed_workspace (WnckWindow   *window,
+					WnckTasklist *tasklist)
+{
+  wnck_tasklist_index_remove_window (tasklist, window);
+  wnck_tasklist_index_add_window (tasklist, window);
+
+  if (wnck_tasklist_update_window_task (tasklist, window))
     {
-      wnck_tasklist_update_lists (tasklist);
+      wnck_tasklist_active_window_changed (tasklist->priv->screen,
+                                           NULL, tasklist);
       gtk_widget_queue_resize (GTK_WIDGET (tasklist));
     }
 }
@@ -2479,6 +3005,8 @@ static void
 wnck_tasklist_connect_window (WnckTasklist *tasklist,
 			      WnckWindow   *window)
 {
+  wnck_tasklist_index_add_window (tasklist, window);
+
   g_signal_connect_object (window, "workspace_changed",
 			   G_CALLBACK (wnck_tasklist_window_changed_workspace),
 			   tasklist, 0);
@@ -2491,6 +3019,8 @@ static void
 wnck_tasklist_disconnect_window (WnckTasklist *tasklist,
 			         WnckWindow   *window)
 {
+  wnck_tasklist_index_remove_window (tasklist, window);
+
   g_signal_handlers_disconnect_by_func (window,
                                         wnck_tasklist_window_changed_workspace,
                                         tasklist);
@@ -2519,6 +3049,8 @@ wnck_tasklist_window_removed (WnckScreen   *screen,
 			      WnckWindow   *win,
 			      WnckTasklist *tasklist)
 {
+  wnck_tasklist_index_remove_window (tasklist, win);
+
   wnck_tasklist_update_lists (tasklist);
   gtk_widget_queue_resize (GTK_WIDGET (tasklist));
 }
@@ -2702,8 +3234,11 @@ wnck_task_close_all (GtkMenuItem *menu_item,
  		     gpointer     data)
 {
   WnckTask *task = WNCK_TASK (data);
+  WnckWindowBatch *batch;
   GList *l;
 
+  batch = wnck_window_batch_begin (task->tasklist->priv->screen);
+
   l = task->windows;
   while (l)
     {
@@ -2711,6 +3246,8 @@ wnck_task_close_all (GtkMenuItem *menu_item,
       wnck_window_close (child->window, gtk_get_current_event_time ());
       l = l->next;
     }
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
@@ -2718,8 +3255,11 @@ wnck_task_unminimize_all (GtkMenuItem *menu_item,
 		          gpointer     data)
 {
   WnckTask *task = WNCK_TASK (data);
+  WnckWindowBatch *batch;
   GList *l;
 
+  batch = wnck_window_batch_begin (task->tasklist->priv->screen);
+
   l = task->windows;
   while (l)
     {
@@ -2730,6 +3270,8 @@ wnck_task_unminimize_all (GtkMenuItem *menu_item,
       wnck_window_unminimize (child->window, gtk_get_current_event_time ());
       l = l->next;
     }
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
@@ -2737,8 +3279,11 @@ wnck_task_minimize_all (GtkMenuItem *menu_item,
   		        gpointer     data)
 {
   WnckTask *task = WNCK_TASK (data);
+  WnckWindowBatch *batch;
   GList *l;
 
+  batch = wnck_window_batch_begin (task->tasklist->priv->screen);
+
   l = task->windows;
   while (l)
     {
@@ -2746,6 +3291,8 @@ wnck_task_minimize_all (GtkMenuItem *menu_item,
       wnck_window_minimize (child->window);
       l = l->next;
     }
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
@@ -2753,8 +3300,11 @@ wnck_task_unmaximize_all (GtkMenuItem *menu_item,
   		        gpointer     data)
 {
   WnckTask *task = WNCK_TASK (data);
+  WnckWindowBatch *batch;
   GList *l;
 
+  batch = wnck_window_batch_begin (task->tasklist->priv->screen);
+
   l = task->windows;
   while (l)
     {
@@ -2762,6 +3312,8 @@ wnck_task_unmaximize_all (GtkMenuItem *menu_item,
       wnck_window_unmaximize (child->window);
       l = l->next;
     }
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
@@ -2769,8 +3321,11 @@ wnck_task_maximize_all (GtkMenuItem *menu_item,
   		        gpointer     data)
 {
   WnckTask *task = WNCK_TASK (data);
+  WnckWindowBatch *batch;
   GList *l;
 
+  batch = wnck_window_batch_begin (task->tasklist->priv->screen);
+
   l = task->windows;
   while (l)
     {
@@ -2778,18 +3333,86 @@ wnck_task_maximize_all (GtkMenuItem *menu_item,
       wnck_window_maximize (child->window);
       l = l->next;
     }
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
-wnck_task_popup_menu (WnckTask *task,
-                      gboolean  action_submenu)
+wnck_task_append_menu_item (WnckTask  *win_task,
+                            GtkWidget *menu,
+                            gboolean   action_submenu)
 {
-  GtkWidget *menu;
-  WnckTask *win_task;
   char *text;
   GdkPixbuf *pixbuf;
   GtkWidget *menu_item;
   GtkWidget *image;
+
+  text = wnck_task_get_text (win_task, TRUE, TRUE);
+  menu_item = gtk_image_menu_item_new_with_label (text);
+  g_free (text);
+
+  gtk_image_menu_item_set_always_show_image (GTK_IMAGE_MENU_ITEM (menu_item),
+                                             TRUE);
+
+  if (wnck_task_get_needs_attention (win_task))
+    _make_gtk_label_bold (GTK_LABEL (gtk_bin_get_child (GTK_BIN (menu_item))));
+
+  text = wnck_task_get_text (win_task, FALSE, FALSE);
+  gtk_widget_set_tooltip_text (menu_item, text);
+  g_free (text);
+
+  pixbuf = wnck_task_get_icon (win_task);
+  if (pixbuf)
+    {
+      image = gtk_image_new_from_pixbuf (pixbuf);
+      gtk_widget_show (image);
+      gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM (menu_item),
+                                     image);
+      g_object_unref (pixbuf);
+    }
+
+  gtk_widget_show (menu_item);
+
+  if (action_submenu)
+    gtk_menu_item_set_submenu (GTK_MENU_ITEM (menu_item),
+                               wnck_action_menu_new (win_task->window));
+  else
+    {
+      static const GtkTargetEntry targets[] = {
+        { "application/x-wnck-window-id", 0, 0 }
+      };
+
+      g_signal_connect_object (G_OBJECT (menu_item), "activate",
+                               G_CALLBACK (wnck_task_menu_activated),
+                               G_OBJECT (win_task),
+                               0);
+
+
+      gtk_drag_source_set (menu_item, GDK_BUTTON1_MASK,
+                           targets, 1, GDK_ACTION_MOVE);
+      g_signal_connect_object (G_OBJECT(menu_item), "drag_begin",
+                               G_CALLBACK (wnck_task_drag_begin),
+                               G_OBJECT (win_task),
+                               0);
+      g_signal_connect_object (G_OBJECT(menu_item), "drag_end",
+                               G_CALLBACK (wnck_task_drag_end),
+                               G_OBJECT (win_task),
+                               0);
+      g_signal_connect_object (G_OBJECT(menu_item), "drag_data_get",
+                               G_CALLBACK (wnck_task_drag_data_get),
+                               G_OBJECT (win_task),
+                               0);
+    }
+
+  gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
+}
+
+static void
+wnck_task_popup_menu (WnckTask *task,
+                      gboolean  action_submenu)
+{
+  GtkWidget *menu;
+  GtkWidget *menu_item;
   GList *l, *list;
 
   g_return_if_fail (task->type == WNCK_TASK_CLASS_GROUP);
@@ -2819,66 +3442,7 @@ wnck_task_popup_menu (WnckTask *task,
   l = task->windows;
   while (l)
     {
-      win_task = WNCK_TASK (l->data);
-
-      text = wnck_task_get_text (win_task, TRUE, TRUE);
-      menu_item = gtk_image_menu_item_new_with_label (text);
-      g_free (text);
-
-      gtk_image_menu_item_set_always_show_image (GTK_IMAGE_MENU_ITEM (menu_item),
-                                                 TRUE);
-
-      if (wnck_task_get_needs_attention (win_task))
-        _make_gtk_label_bold (GTK_LABEL (gtk_bin_get_child (GTK_BIN (menu_item))));
-
-      text = wnck_task_get_text (win_task, FALSE, FALSE);
-      gtk_widget_set_tooltip_text (menu_item, text);
-      g_free (text);
-
-      pixbuf = wnck_task_get_icon (win_task);
-      if (pixbuf)
-	{
-	  image = gtk_image_new_from_pixbuf (pixbuf);
-	  gtk_widget_show (image);
-	  gtk_image_menu_item_set_image (GTK_IMAGE_MENU_ITEM (menu_item),
-					 image);
-	  g_object_unref (pixbuf);
-	}
-
-      gtk_widget_show (menu_item);
-
-      if (action_submenu)
-        gtk_menu_item_set_submenu (GTK_MENU_ITEM (menu_item),
-                                   wnck_action_menu_new (win_task->window));
-      else
-        {
-          static const GtkTargetEntry targets[] = {
-            { "application/x-wnck-window-id", 0, 0 }
-          };
-
-          g_signal_connect_object (G_OBJECT (menu_item), "activate",
-                                   G_CALLBACK (wnck_task_menu_activated),
-                                   G_OBJECT (win_task),
-                                   0);
-
-
-          gtk_drag_source_set (menu_item, GDK_BUTTON1_MASK,
-                               targets, 1, GDK_ACTION_MOVE);
-          g_signal_connect_object (G_OBJECT(menu_item), "drag_begin",
-                                   G_CALLBACK (wnck_task_drag_begin),
-                                   G_OBJECT (win_task),
-                                   0);
-          g_signal_connect_object (G_OBJECT(menu_item), "drag_end",
-                                   G_CALLBACK (wnck_task_drag_end),
-                                   G_OBJECT (win_task),
-                                   0);
-          g_signal_connect_object (G_OBJECT(menu_item), "drag_data_get",
-                                   G_CALLBACK (wnck_task_drag_data_get),
-                                   G_OBJECT (win_task),
-                                   0);
-        }
-
-      gtk_menu_shell_append (GTK_MENU_SHELL (menu), menu_item);
+      wnck_task_append_menu_item (WNCK_TASK (l->data), menu, action_submenu);
 
       l = l->next;
     }
@@ -2957,6 +3521,56 @@ wnck_task_popup_menu (WnckTask *task,
 		  1, gtk_get_current_event_time ());
 }
 
+static void
+wnck_tasklist_overflow_clicked (GtkButton    *button,
+                                WnckTasklist *tasklist)
+{
+  GtkWidget *menu;
+  GList *l, *list;
+
+  if (tasklist->priv->overflow_menu == NULL)
+    {
+      tasklist->priv->overflow_menu = gtk_menu_new ();
+      g_object_ref_sink (tasklist->priv->overflow_menu);
+    }
+
+  menu = tasklist->priv->overflow_menu;
+
+  /* Remove old menu content */
+  list = gtk_container_get_children (GTK_CONTAINER (menu));
+  for (l = list; l; l = l->next)
+    gtk_container_remove (GTK_CONTAINER (menu), GTK_WIDGET (l->data));
+  g_list_free (list);
+
+  for (l = tasklist->priv->overflow_tasks; l; l = l->next)
+    {
+      WnckTask *task = WNCK_TASK (l->data);
+      GList *w;
+
+      switch (task->type)
+        {
+        case WNCK_TASK_CLASS_GROUP:
+          for (w = task->windows; w; w = w->next)
+            wnck_task_append_menu_item (WNCK_TASK (w->data), menu, FALSE);
+          break;
+        case WNCK_TASK_WINDOW:
+          wnck_task_append_menu_item (task, menu, FALSE);
+          break;
+        case WNCK_TASK_STARTUP_SEQUENCE:
+          break;
+        }
+    }
+
+  gtk_menu_set_screen (GTK_MENU (menu),
+		       _wnck_screen_get_gdk_screen (tasklist->priv->screen));
+
+  gtk_widget_show (menu);
+  gtk_menu_popup (GTK_MENU (menu),
+		  NULL, NULL,
+		  wnck_task_position_menu, button,
+		  1, gtk_get_current_event_time ());
+}
+
 static void
 wnck_task_button_toggled (GtkButton *button,
 			  WnckTask  *task)
@@ -7,6 +7,7 @@ static int n_rows = 1;
 static gboolean only_current = FALSE;
 static gboolean rtl = FALSE;
 static gboolean show_name = FALSE;
+static gboolean thumbnails = FALSE;
 static gboolean vertical = FALSE;
 
 static GOptionEntry entries[] = {
@@ -14,6 +15,7 @@ static GOptionEntry entries[] = {
 	{"only-current", 'c', 0, G_OPTION_ARG_NONE, &only_current, "Only show current workspace", NULL},
 	{"rtl", 'r', 0, G_OPTION_ARG_NONE, &rtl, "Use RTL as default direction", NULL},
 	{"show-name", 's', 0, G_OPTION_ARG_NONE, &show_name, "Show workspace names instead of workspace contents", NULL},
+	{"thumbnails", 't', 0, G_OPTION_ARG_NONE, &thumbnails, "Show live thumbnails of the windows", NULL},
 	{"vertical-orientation", 'v', 0, G_OPTION_ARG_NONE, &vertical, "Use a vertical orientation", NULL},
 	{NULL }
 };
@@ -79,6 +81,12 @@ main (int argc, char **argv)
 
   screen = wnck_screen_get_default ();
 
+  /* the pager uses neither the icon names nor the allowed actions */
+  wnck_screen_set_interest (screen,
+                            WNCK_SCREEN_INTEREST_NAMES |
+                            WNCK_SCREEN_INTEREST_ICONS |
+                            WNCK_SCREEN_INTEREST_FRAME_EXTENTS);
+
   /* because the pager doesn't respond to signals at the moment */
   wnck_screen_force_update (screen);
 
@@ -89,6 +97,8 @@ main (int argc, char **argv)
 
   if (show_name)
 	  mode = WNCK_PAGER_DISPLAY_NAME;
+  else if (thumbnails)
+	  mode = WNCK_PAGER_DISPLAY_THUMBNAILS;
   else
 	  mode = WNCK_PAGER_DISPLAY_CONTENT;
 
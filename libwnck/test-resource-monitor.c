@@ -0,0 +1,92 @@
+/* vim: set sw=2 et: */
+
+#include <libwnck/libwnck.h>
+
+static void
+on_usage_changed (WnckResourceMonitor          *monitor,
+                  WnckApplication              *app,
+                  const WnckResourceUsageDelta *delta,
+                  gpointer                      data)
+{
+  g_print ("%s: %+ld bytes (%+ld pixmap bytes, %+d pixmaps, %+d windows) in %" G_GINT64_FORMAT " ms\n",
+           wnck_application_get_name (app),
+           delta->total_bytes_estimate,
+           delta->pixmap_bytes,
+           delta->n_pixmaps,
+           delta->n_windows,
+           delta->period / 1000);
+}
+
+static void
+print_growth (WnckResourceMonitor *monitor,
+              WnckScreen          *screen)
+{
+  GList *l;
+
+  for (l = wnck_screen_get_windows (screen); l; l = l->next)
+    {
+      WnckApplication *app;
+      WnckResourceUsageDelta delta;
+
+      app = wnck_window_get_application (l->data);
+
+      /* one line per application, for its first window */
+      if (app == NULL ||
+          wnck_application_get_windows (app)->data != l->data)
+        continue;
+
+      if (wnck_resource_monitor_get_delta (monitor, app, &delta))
+        g_print ("%s: %+ld bytes since the oldest sample\n",
+                 wnck_application_get_name (app),
+                 delta.total_bytes_estimate);
+    }
+}
+
+static gboolean
+quit_loop (gpointer data)
+{
+  GMainLoop *loop = data;
+  g_main_loop_quit (loop);
+
+  return FALSE;
+}
+
+int
+main (int    argc,
+      char **argv)
+{
+  GMainLoop *loop;
+  WnckScreen *screen;
+  WnckResourceMonitor *monitor;
+
+  gdk_init (&argc, &argv);
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  screen = wnck_screen_get_default ();
+  wnck_screen_force_update (screen);
+
+  monitor = wnck_resource_monitor_new (screen, 1, 10);
+  g_signal_connect (monitor, "usage-changed",
+                    G_CALLBACK (on_usage_changed), NULL);
+
+  g_print ("sampling the X resource usage every second for 10 seconds\n");
+  wnck_resource_monitor_sample (monitor);
+  g_timeout_add_seconds (10, quit_loop, loop);
+  g_main_loop_run (loop);
+
+  print_growth (monitor, screen);
+
+  /* the monitor must survive its screen */
+  g_print ("libwnck is shutting down for 3 seconds; no sample will be taken anymore\n");
+  wnck_shutdown ();
+  g_timeout_add_seconds (3, quit_loop, loop);
+  g_main_loop_run (loop);
+
+  wnck_resource_monitor_sample (monitor);
+  g_object_unref (monitor);
+
+  g_main_loop_unref (loop);
+
+  return 0;
+}
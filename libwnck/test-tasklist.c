@@ -9,6 +9,7 @@ static gboolean always_group = FALSE;
 static gboolean rtl = FALSE;
 static gboolean skip_tasklist = FALSE;
 static gboolean transparent = FALSE;
+static gboolean virtualized = FALSE;
 
 static GOptionEntry entries[] = {
 	{"always-group", 'g', 0, G_OPTION_ARG_NONE, &always_group, "Always group windows", NULL},
@@ -17,6 +18,7 @@ static GOptionEntry entries[] = {
 	{"rtl", 'r', 0, G_OPTION_ARG_NONE, &rtl, "Use RTL as default direction", NULL},
 	{"skip-tasklist", 's', 0, G_OPTION_ARG_NONE, &skip_tasklist, "Don't show window in tasklist", NULL},
 	{"transparent", 't', 0, G_OPTION_ARG_NONE, &transparent, "Enable Transparency", NULL},
+	{"virtualized", 'v', 0, G_OPTION_ARG_NONE, &virtualized, "Only allocate the buttons that fit", NULL},
 	{NULL }
 };
 
@@ -85,6 +87,7 @@ main (int argc, char **argv)
   tasklist = wnck_tasklist_new ();
 
   wnck_tasklist_set_include_all_workspaces (WNCK_TASKLIST (tasklist), display_all);
+  wnck_tasklist_set_virtualized (WNCK_TASKLIST (tasklist), virtualized);
   if (always_group)
     wnck_tasklist_set_grouping (WNCK_TASKLIST (tasklist),
                                 WNCK_TASKLIST_ALWAYS_GROUP);
@@ -130,6 +130,128 @@ wnck_init_resource_usage (GdkDisplay *gdisplay)
   return status;
 }
 
+#ifdef HAVE_XRES
+enum
+{
+  RESOURCE_PIXMAP,
+  RESOURCE_WINDOW,
+  RESOURCE_GC,
+  RESOURCE_PICTURE,
+  RESOURCE_GLYPHSET,
+  RESOURCE_FONT,
+  RESOURCE_COLORMAP_ENTRY,
+  RESOURCE_PASSIVE_GRAB,
+  RESOURCE_CURSOR,
+  N_RESOURCE_TYPES
+};
+
+static const char *resource_type_names[N_RESOURCE_TYPES] = {
+  "PIXMAP",
+  "WINDOW",
+  "GC",
+  "PICTURE",
+  "GLYPHSET",
+  "FONT",
+  "COLORMAP ENTRY",
+  "PASSIVE GRAB",
+  "CURSOR"
+};
+
+/* The atoms of the resource types, looked up once per display */
+static const Atom *
+wnck_resource_usage_get_atoms (GdkDisplay *gdisplay)
+{
+  Atom *atoms;
+  int i;
+
+  atoms = g_object_get_data (G_OBJECT (gdisplay), "wnck-xres-resource-atoms");
+
+  if (atoms == NULL)
+    {
+      atoms = g_new (Atom, N_RESOURCE_TYPES);
+
+      for (i = 0; i < N_RESOURCE_TYPES; i++)
+        atoms[i] = gdk_x11_get_xatom_by_name_for_display (gdisplay,
+                                                          resource_type_names[i]);
+
+      g_object_set_data_full (G_OBJECT (gdisplay), "wnck-xres-resource-atoms",
+                              atoms, g_free);
+    }
+
+  return atoms;
+}
+
+static void
+wnck_resource_usage_add (WnckResourceUsage *usage,
+                         const Atom        *atoms,
+                         Atom               type,
+                         int                count)
+{
+  if (type == atoms[RESOURCE_PIXMAP])
+    usage->n_pixmaps += count;
+  else if (type == atoms[RESOURCE_WINDOW])
+    usage->n_windows += count;
+  else if (type == atoms[RESOURCE_GC])
+    usage->n_gcs += count;
+  else if (type == atoms[RESOURCE_PICTURE])
+    usage->n_pictures += count;
+  else if (type == atoms[RESOURCE_GLYPHSET])
+    usage->n_glyphsets += count;
+  else if (type == atoms[RESOURCE_FONT])
+    usage->n_fonts += count;
+  else if (type == atoms[RESOURCE_COLORMAP_ENTRY])
+    usage->n_colormap_entries += count;
+  else if (type == atoms[RESOURCE_PASSIVE_GRAB])
+    usage->n_passive_grabs += count;
+  else if (type == atoms[RESOURCE_CURSOR])
+    usage->n_cursors += count;
+  else
+    usage->n_other += count;
+}
+
+static void
+wnck_resource_usage_estimate_total (WnckResourceUsage *usage)
+{
+  usage->total_bytes_estimate = usage->pixmap_bytes;
+
+  /* FIXME look in the X server source and come up with better
+   * answers here. Ideally we change XRes to return a number
+   * like this since it can do things like divide the cost of
+   * a shared resource among those sharing it.
+   */
+  usage->total_bytes_estimate += usage->n_windows * 24;
+  usage->total_bytes_estimate += usage->n_gcs * 24;
+  usage->total_bytes_estimate += usage->n_pictures * 24;
+  usage->total_bytes_estimate += usage->n_glyphsets * 24;
+  usage->total_bytes_estimate += usage->n_fonts * 1024;
+  usage->total_bytes_estimate += usage->n_colormap_entries * 24;
+  usage->total_bytes_estimate += usage->n_passive_grabs * 24;
+  usage->total_bytes_estimate += usage->n_cursors * 24;
+  usage->total_bytes_estimate += usage->n_other * 24;
+}
+
+static void
+wnck_resource_usage_fill (GdkDisplay        *gdisplay,
+                          WnckResourceUsage *usage,
+                          XResType          *types,
+                          int                n_types,
+                          unsigned long      pixmap_bytes)
+{
+  const Atom *atoms;
+  int i;
+
+  atoms = wnck_resource_usage_get_atoms (gdisplay);
+
+  usage->pixmap_bytes = pixmap_bytes;
+
+  for (i = 0; i < n_types; i++)
+    wnck_resource_usage_add (usage, atoms,
+                             types[i].resource_type, types[i].count);
+
+  wnck_resource_usage_estimate_total (usage);
+}
+#endif /* HAVE_XRES */
+
 /**
  * wnck_xid_read_resource_usage:
  * @gdk_display: a <classname>GdkDisplay</classname>.
@@ -163,16 +285,6 @@ wnck_xid_read_resource_usage (GdkDisplay        *gdisplay,
    XResType *types;
    int n_types;
    unsigned long pixmap_bytes;
-   int i;
-   Atom pixmap_atom;
-   Atom window_atom;
-   Atom gc_atom;
-   Atom picture_atom;
-   Atom glyphset_atom;
-   Atom font_atom;
-   Atom colormap_entry_atom;
-   Atom passive_grab_atom;
-   Atom cursor_atom;
 
    types = NULL;
    n_types = 0;
@@ -190,65 +302,9 @@ wnck_xid_read_resource_usage (GdkDisplay        *gdisplay,
                                xid, &pixmap_bytes);
    _wnck_error_trap_pop (xdisplay);
 
-   usage->pixmap_bytes = pixmap_bytes;
-
-   pixmap_atom = _wnck_atom_get ("PIXMAP");
-   window_atom = _wnck_atom_get ("WINDOW");
-   gc_atom = _wnck_atom_get ("GC");
-   font_atom = _wnck_atom_get ("FONT");
-   glyphset_atom = _wnck_atom_get ("GLYPHSET");
-   picture_atom = _wnck_atom_get ("PICTURE");
-   colormap_entry_atom = _wnck_atom_get ("COLORMAP ENTRY");
-   passive_grab_atom = _wnck_atom_get ("PASSIVE GRAB");
-   cursor_atom = _wnck_atom_get ("CURSOR");
-
-   i = 0;
-   while (i < n_types)
-     {
-       int t = types[i].resource_type;
-
-       if (t == pixmap_atom)
-         usage->n_pixmaps += types[i].count;
-       else if (t == window_atom)
-         usage->n_windows += types[i].count;
-       else if (t == gc_atom)
-         usage->n_gcs += types[i].count;
-       else if (t == picture_atom)
-         usage->n_pictures += types[i].count;
-       else if (t == glyphset_atom)
-         usage->n_glyphsets += types[i].count;
-       else if (t == font_atom)
-         usage->n_fonts += types[i].count;
-       else if (t == colormap_entry_atom)
-         usage->n_colormap_entries += types[i].count;
-       else if (t == passive_grab_atom)
-         usage->n_passive_grabs += types[i].count;
-       else if (t == cursor_atom)
-         usage->n_cursors += types[i].count;
-       else
-         usage->n_other += types[i].count;
-
-       ++i;
-     }
+   wnck_resource_usage_fill (gdisplay, usage, types, n_types, pixmap_bytes);
 
    XFree(types);
-
-   usage->total_bytes_estimate = usage->pixmap_bytes;
-
-   /* FIXME look in the X server source and come up with better
-    * answers here. Ideally we change XRes to return a number
-    * like this since it can do things like divide the cost of
-    * a shared resource among those sharing it.
-    */
-   usage->total_bytes_estimate += usage->n_windows * 24;
-   usage->total_bytes_estimate += usage->n_gcs * 24;
-   usage->total_bytes_estimate += usage->n_pictures * 24;
-   usage->total_bytes_estimate += usage->n_glyphsets * 24;
-   usage->total_bytes_estimate += usage->n_fonts * 1024;
-   usage->total_bytes_estimate += usage->n_colormap_entries * 24;
-   usage->total_bytes_estimate += usage->n_passive_grabs * 24;
-   usage->total_bytes_estimate += usage->n_cursors * 24;
-   usage->total_bytes_estimate += usage->n_other * 24;
  }
 #else /* HAVE_XRES */
   g_assert_not_reached ();
@@ -338,6 +394,20 @@ wnck_find_pid_for_resource_r (Display *xdisplay,
     XFree ((char *)children);
 }
 
+/* What we found for an X client in the previous walk of the window tree */
+typedef struct
+{
+  int    screen;
+  gulong xid;
+  gulong pid;
+} WnckXResClientPid;
+
+static void
+wnck_pid_read_resource_usage_free_client_pid (gpointer data)
+{
+  g_slice_free (WnckXResClientPid, data);
+}
+
 struct xresclient_state
 {
   XResClient *clients;
@@ -345,11 +415,14 @@ struct xresclient_state
   int         next;
   Display    *xdisplay;
   GHashTable *hashtable_pid;
+  GHashTable *client_pids;
 };
 
-static struct xresclient_state xres_state = { NULL, 0, -1, NULL, NULL };
+static struct xresclient_state xres_state = { NULL, 0, -1, NULL, NULL, NULL };
 static guint       xres_idleid = 0;
 static GHashTable *xres_hashtable = NULL;
+/* client resource base -> WnckXResClientPid */
+static GHashTable *xres_client_pids = NULL;
 static time_t      start_update = 0;
 static time_t      end_update = 0;
 static guint       xres_removeid = 0;
@@ -372,6 +445,28 @@ wnck_pid_read_resource_usage_xres_state_free (gpointer data)
   if (state->hashtable_pid)
     g_hash_table_destroy (state->hashtable_pid);
   state->hashtable_pid = NULL;
+
+  if (state->client_pids)
+    g_hash_table_destroy (state->client_pids);
+  state->client_pids = NULL;
+}
+
+/* Checks that the window where we found the PID of a client in the previous
+ * walk still belongs to this client, so we don't need to walk the tree
+ * again for it */
+static gboolean
+wnck_pid_read_resource_usage_check_client_pid (Display           *xdisplay,
+                                               XID                match_xid,
+                                               XID                mask,
+                                               WnckXResClientPid *client_pid)
+{
+  if (client_pid->screen >= ScreenCount (xdisplay))
+    return FALSE;
+
+  return wnck_check_window_for_pid (ScreenOfDisplay (xdisplay,
+                                                     client_pid->screen),
+                                    client_pid->xid,
+                                    match_xid, mask) == client_pid->pid;
 }
 
 static gboolean
@@ -389,6 +484,11 @@ wnck_pid_read_resource_usage_fill_cache (struct xresclient_state *state)
       xres_hashtable = state->hashtable_pid;
       state->hashtable_pid = NULL;
 
+      if (xres_client_pids)
+        g_hash_table_destroy (xres_client_pids);
+      xres_client_pids = state->client_pids;
+      state->client_pids = NULL;
+
       time (&end_update);
 
       xres_idleid = 0;
@@ -400,8 +500,29 @@ wnck_pid_read_resource_usage_fill_cache (struct xresclient_state *state)
 
   pid = 0;
   xid = 0;
+  i = 0;
 
-  for (i = 0; i < ScreenCount (state->xdisplay); i++)
+  /* only walk the window tree for clients that are new since the last
+   * walk */
+  if (xres_client_pids)
+    {
+      WnckXResClientPid *client_pid;
+
+      client_pid = g_hash_table_lookup (xres_client_pids,
+                                        GUINT_TO_POINTER (match_xid));
+      if (client_pid &&
+          wnck_pid_read_resource_usage_check_client_pid (state->xdisplay,
+                                                         match_xid,
+                                                         state->clients[state->next].resource_mask,
+                                                         client_pid))
+        {
+          pid = client_pid->pid;
+          xid = client_pid->xid;
+          i = client_pid->screen;
+        }
+    }
+
+  for (; pid == 0 && i < ScreenCount (state->xdisplay); i++)
     {
       Screen *screen;
       Window  root;
@@ -424,12 +545,20 @@ wnck_pid_read_resource_usage_fill_cache (struct xresclient_state *state)
     {
       gulong *key;
       gulong *value;
+      WnckXResClientPid *client_pid;
 
       key = g_slice_new (gulong);
       value = g_slice_new (gulong);
       *key = pid;
       *value = xid;
       g_hash_table_insert (state->hashtable_pid, key, value);
+
+      client_pid = g_slice_new (WnckXResClientPid);
+      client_pid->screen = i;
+      client_pid->xid = xid;
+      client_pid->pid = pid;
+      g_hash_table_insert (state->client_pids,
+                           GUINT_TO_POINTER (match_xid), client_pid);
     }
 
   state->next++;
@@ -437,6 +566,180 @@ wnck_pid_read_resource_usage_fill_cache (struct xresclient_state *state)
   return TRUE;
 }
 
+static GHashTable *
+wnck_pid_read_resource_usage_new_hash_table (void)
+{
+  return g_hash_table_new_full (wnck_gulong_hash,
+                                wnck_gulong_equal,
+                                wnck_pid_read_resource_usage_free_hash,
+                                wnck_pid_read_resource_usage_free_hash);
+}
+
+#ifdef HAVE_XRES_CLIENT_IDS
+static gboolean
+wnck_have_xres_client_ids (GdkDisplay *gdisplay)
+{
+  WnckExtStatus status;
+
+  status = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (gdisplay),
+                                               "wnck-xres-client-ids-status"));
+
+  if (status == WNCK_EXT_UNKNOWN)
+    {
+      int major, minor;
+
+      /* XResQueryClientIds() needs version 1.2 */
+      if (XResQueryVersion (GDK_DISPLAY_XDISPLAY (gdisplay), &major, &minor) &&
+          (major > 1 || (major == 1 && minor >= 2)))
+        status = WNCK_EXT_FOUND;
+      else
+        status = WNCK_EXT_MISSING;
+
+      g_object_set_data (G_OBJECT (gdisplay),
+                         "wnck-xres-client-ids-status",
+                         GINT_TO_POINTER (status));
+    }
+
+  return status == WNCK_EXT_FOUND;
+}
+#endif /* HAVE_XRES_CLIENT_IDS */
+
+typedef struct
+{
+  XID    client; /* resource base of the client */
+  gulong pid;
+} WnckXResClientId;
+
+/* With version 1.2 of XRes, the X server knows the PID of its local clients
+ * and can tell us all of them in one request: no need to look for windows
+ * with _NET_WM_PID then. Returns NULL if this is not supported.
+ *
+ * Must be called with an error trap pushed: only the status of the request is
+ * checked, so that the caller can pop the trap once all its requests are
+ * done. */
+static GArray *
+wnck_xres_read_client_pids (GdkDisplay *gdisplay)
+{
+#ifdef HAVE_XRES_CLIENT_IDS
+  Display           *xdisplay;
+  XResClientIdSpec   spec;
+  XResClientIdValue *ids;
+  long               n_ids;
+  GArray            *client_ids;
+  long               i;
+
+  if (!wnck_have_xres_client_ids (gdisplay))
+    return NULL;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdisplay);
+
+  /* a client of None means all clients */
+  spec.client = None;
+  spec.mask = XRES_CLIENT_ID_PID_MASK;
+
+  ids = NULL;
+  n_ids = 0;
+
+  if (XResQueryClientIds (xdisplay, 1, &spec, &n_ids, &ids) != Success)
+    return NULL;
+
+  client_ids = g_array_sized_new (FALSE, FALSE, sizeof (WnckXResClientId),
+                                  n_ids);
+
+  for (i = 0; i < n_ids; i++)
+    {
+      WnckXResClientId client_id;
+      pid_t pid;
+
+      if (XResGetClientIdType (&ids[i]) != XRES_CLIENT_ID_PID)
+        continue;
+
+      pid = XResGetClientPid (&ids[i]);
+      if (pid <= 0)
+        continue;
+
+      client_id.client = ids[i].spec.client;
+      client_id.pid = pid;
+      g_array_append_val (client_ids, client_id);
+    }
+
+  XResClientIdsDestroy (n_ids, ids);
+
+  return client_ids;
+#else
+  return NULL;
+#endif /* HAVE_XRES_CLIENT_IDS */
+}
+
+/* Like wnck_xres_read_client_pids(), with its own error trap. */
+static GArray *
+wnck_xres_query_client_pids (GdkDisplay *gdisplay)
+{
+#ifdef HAVE_XRES_CLIENT_IDS
+  Display *xdisplay;
+  GArray  *client_ids;
+
+  if (!wnck_have_xres_client_ids (gdisplay))
+    return NULL;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdisplay);
+
+  _wnck_error_trap_push (xdisplay);
+  client_ids = wnck_xres_read_client_pids (gdisplay);
+  if (_wnck_error_trap_pop (xdisplay) != Success && client_ids)
+    {
+      g_array_free (client_ids, TRUE);
+      client_ids = NULL;
+    }
+
+  return client_ids;
+#else
+  return NULL;
+#endif /* HAVE_XRES_CLIENT_IDS */
+}
+
+static gboolean
+wnck_pid_read_resource_usage_build_cache_from_client_ids (GdkDisplay *gdisplay)
+{
+  GArray     *client_ids;
+  GHashTable *hashtable_pid;
+  guint       i;
+
+  client_ids = wnck_xres_query_client_pids (gdisplay);
+  if (client_ids == NULL)
+    return FALSE;
+
+  time (&start_update);
+
+  hashtable_pid = wnck_pid_read_resource_usage_new_hash_table ();
+
+  for (i = 0; i < client_ids->len; i++)
+    {
+      WnckXResClientId *client_id;
+      gulong *key;
+      gulong *value;
+
+      client_id = &g_array_index (client_ids, WnckXResClientId, i);
+
+      key = g_slice_new (gulong);
+      value = g_slice_new (gulong);
+      *key = client_id->pid;
+      /* any resource of the client works for XResQueryClientResources() */
+      *value = client_id->client;
+      g_hash_table_insert (hashtable_pid, key, value);
+    }
+
+  g_array_free (client_ids, TRUE);
+
+  if (xres_hashtable)
+    g_hash_table_destroy (xres_hashtable);
+  xres_hashtable = hashtable_pid;
+
+  time (&end_update);
+
+  return TRUE;
+}
+
 static void
 wnck_pid_read_resource_usage_start_build_cache (GdkDisplay *gdisplay)
 {
@@ -446,6 +749,9 @@ wnck_pid_read_resource_usage_start_build_cache (GdkDisplay *gdisplay)
   if (xres_idleid != 0)
     return;
 
+  if (wnck_pid_read_resource_usage_build_cache_from_client_ids (gdisplay))
+    return;
+
   time (&start_update);
 
   xdisplay = GDK_DISPLAY_XDISPLAY (gdisplay);
@@ -459,11 +765,9 @@ wnck_pid_read_resource_usage_start_build_cache (GdkDisplay *gdisplay)
 
   xres_state.next = (xres_state.n_clients > 0) ? 0 : -1;
   xres_state.xdisplay = xdisplay;
-  xres_state.hashtable_pid = g_hash_table_new_full (
-                                     wnck_gulong_hash,
-                                     wnck_gulong_equal,
-                                     wnck_pid_read_resource_usage_free_hash,
-                                     wnck_pid_read_resource_usage_free_hash);
+  xres_state.hashtable_pid = wnck_pid_read_resource_usage_new_hash_table ();
+  xres_state.client_pids = g_hash_table_new_full (NULL, NULL, NULL,
+                                                  wnck_pid_read_resource_usage_free_client_pid);
 
   xres_idleid = g_idle_add_full (
                         G_PRIORITY_HIGH_IDLE,
@@ -481,6 +785,11 @@ wnck_pid_read_resource_usage_destroy_hash_table (gpointer data)
 
   xres_hashtable = NULL;
 
+  if (xres_client_pids)
+    g_hash_table_destroy (xres_client_pids);
+
+  xres_client_pids = NULL;
+
   return FALSE;
 }
 
@@ -522,6 +831,12 @@ wnck_pid_read_resource_usage_from_cache (GdkDisplay        *gdisplay,
   else
     xid_p = NULL;
 
+  /* a new client: when the cache can be built with one request, just do it
+   * again, at most once per second */
+  if (xid_p == NULL && !need_rebuild && end_update != time (NULL) &&
+      wnck_pid_read_resource_usage_build_cache_from_client_ids (gdisplay))
+    xid_p = g_hash_table_lookup (xres_hashtable, &pid);
+
   if (xid_p)
     {
       wnck_xid_read_resource_usage (gdisplay, *xid_p, usage);
@@ -587,9 +902,12 @@ wnck_pid_read_resource_usage_no_cache (GdkDisplay        *gdisplay,
  *
  * In order to find the resource usage of an application that does not have an
  * X window visible to libwnck (panel applets do not have any toplevel windows,
- * for example), wnck_pid_read_resource_usage() walks through the whole tree of
- * X windows. Since this walk is expensive in CPU, a cache is created. This
- * cache is updated in the background. This means there is a non-null
+ * for example), wnck_pid_read_resource_usage() asks the X server for the
+ * process ID of all its clients when the XRes extension is at least version
+ * 1.2. With older versions, it walks through the whole tree of X windows
+ * instead. Since this walk is expensive in CPU, a cache is created. This
+ * cache is updated in the background, and only clients that appeared since
+ * the last update cause a new walk. This means there is a non-null
  * probability that no resource usage will be found for an application, even if
  * it is an X client. If this happens, calling wnck_pid_read_resource_usage()
  * again after a few seconds should work.
@@ -618,6 +936,233 @@ wnck_pid_read_resource_usage (GdkDisplay        *gdisplay,
 #endif /* HAVE_XRES */
 }
 
+#ifdef HAVE_XRES
+/* With version 1.2 of XRes, the X server gives the size of all the resources
+ * of all the clients in one request, instead of two requests per client.
+ * Returns FALSE if this is not supported, with @usages left empty. */
+static gboolean
+wnck_read_resource_usage_all_sizes (GdkDisplay *gdisplay,
+                                    XResClient *clients,
+                                    int         n_clients,
+                                    GHashTable *client_pids,
+                                    GArray     *usages)
+{
+#ifdef HAVE_XRES_CLIENT_IDS
+  Display               *xdisplay;
+  XResResourceIdSpec     spec;
+  XResResourceSizeValue *sizes;
+  long                   n_sizes;
+  GHashTable            *client_index;
+  const Atom            *atoms;
+  XID                    mask;
+  long                   i;
+
+  if (n_clients == 0 || !wnck_have_xres_client_ids (gdisplay))
+    return FALSE;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdisplay);
+
+  /* None for both means all the resources */
+  spec.resource = None;
+  spec.type = None;
+
+  sizes = NULL;
+  n_sizes = 0;
+
+  /* the caller has pushed an error trap */
+  if (XResQueryResourceBytes (xdisplay, None, 1, &spec,
+                              &n_sizes, &sizes) != Success)
+    return FALSE;
+
+  atoms = wnck_resource_usage_get_atoms (gdisplay);
+
+  /* base of the client -> index in @usages + 1 */
+  client_index = g_hash_table_new (NULL, NULL);
+
+  for (i = 0; i < n_clients; i++)
+    {
+      WnckClientResourceUsage client_usage;
+      XID base;
+
+      memset (&client_usage, '\0', sizeof (client_usage));
+
+      base = clients[i].resource_base & ~clients[i].resource_mask;
+
+      client_usage.xid = base;
+      client_usage.pid = GPOINTER_TO_UINT (g_hash_table_lookup (client_pids,
+                                                                GUINT_TO_POINTER (base)));
+      g_array_append_val (usages, client_usage);
+
+      g_hash_table_insert (client_index, GUINT_TO_POINTER (base),
+                           GUINT_TO_POINTER (usages->len));
+    }
+
+  /* the X server uses the same bits for the client part of all resources */
+  mask = clients[0].resource_mask;
+
+  for (i = 0; i < n_sizes; i++)
+    {
+      XResResourceSizeSpec *size = &sizes[i].size;
+      WnckResourceUsage *usage;
+      guint index;
+
+      index = GPOINTER_TO_UINT (g_hash_table_lookup (client_index,
+                                                     GUINT_TO_POINTER (size->spec.resource & ~mask)));
+      if (index == 0)
+        continue;
+
+      usage = &g_array_index (usages, WnckClientResourceUsage, index - 1).usage;
+
+      wnck_resource_usage_add (usage, atoms, size->spec.type, 1);
+      if (size->spec.type == atoms[RESOURCE_PIXMAP])
+        usage->pixmap_bytes += size->bytes;
+    }
+
+  for (i = 0; i < (long) usages->len; i++)
+    wnck_resource_usage_estimate_total (&g_array_index (usages,
+                                                        WnckClientResourceUsage,
+                                                        i).usage);
+
+  g_hash_table_destroy (client_index);
+  XResResourceSizeValuesDestroy (n_sizes, sizes);
+
+  return TRUE;
+#else
+  return FALSE;
+#endif /* HAVE_XRES_CLIENT_IDS */
+}
+#endif /* HAVE_XRES */
+
+/**
+ * wnck_read_resource_usage_all:
+ * @gdk_display: a <classname>GdkDisplay</classname>.
+ * @usages: (element-type WnckClientResourceUsage): a #GArray of
+ * #WnckClientResourceUsage, which will be filled with one element per X
+ * client.
+ *
+ * Looks for the X resource usage of all X clients on display @gdisplay, and
+ * puts them in @usages, replacing its previous content. This is much cheaper
+ * than calling wnck_xid_read_resource_usage() for each client.
+ *
+ * The process ID of a client is known when the XRes extension is at least
+ * version 1.2, or when wnck_pid_read_resource_usage() found it recently.
+ * Otherwise, the pid field of its #WnckClientResourceUsage is 0.
+ *
+ * To properly work, this function requires the XRes extension on the X server.
+ *
+ * Since: 3.4
+ */
+void
+wnck_read_resource_usage_all (GdkDisplay *gdisplay,
+                              GArray     *usages)
+{
+  g_return_if_fail (GDK_IS_DISPLAY (gdisplay));
+  g_return_if_fail (usages != NULL);
+  g_return_if_fail (g_array_get_element_size (usages) ==
+                    sizeof (WnckClientResourceUsage));
+
+  g_array_set_size (usages, 0);
+
+  if (wnck_init_resource_usage (gdisplay) == WNCK_EXT_MISSING)
+    return;
+
+#ifdef HAVE_XRES
+ {
+  Display    *xdisplay;
+  XResClient *clients;
+  int         n_clients;
+  GArray     *client_ids;
+  GHashTable *client_pids;
+  int         i;
+
+  xdisplay = GDK_DISPLAY_XDISPLAY (gdisplay);
+
+  clients = NULL;
+  n_clients = 0;
+
+  /* one error trap for all the requests, so that we do not wait for the X
+   * server after each one of them */
+  _wnck_error_trap_push (xdisplay);
+
+  XResQueryClients (xdisplay, &n_clients, &clients);
+
+  client_pids = g_hash_table_new (NULL, NULL);
+
+  client_ids = wnck_xres_read_client_pids (gdisplay);
+  if (client_ids)
+    {
+      guint j;
+
+      for (j = 0; j < client_ids->len; j++)
+        {
+          WnckXResClientId *client_id;
+
+          client_id = &g_array_index (client_ids, WnckXResClientId, j);
+          g_hash_table_insert (client_pids,
+                               GUINT_TO_POINTER (client_id->client),
+                               GUINT_TO_POINTER (client_id->pid));
+        }
+
+      g_array_free (client_ids, TRUE);
+    }
+  else if (xres_client_pids)
+    {
+      GHashTableIter iter;
+      gpointer key, value;
+
+      g_hash_table_iter_init (&iter, xres_client_pids);
+      while (g_hash_table_iter_next (&iter, &key, &value))
+        g_hash_table_insert (client_pids, key,
+                             GUINT_TO_POINTER (((WnckXResClientPid *) value)->pid));
+    }
+
+  /* with XRes 1.2, the sizes of all the resources come in one request */
+  if (!wnck_read_resource_usage_all_sizes (gdisplay, clients, n_clients,
+                                           client_pids, usages))
+    {
+      for (i = 0; i < n_clients; i++)
+        {
+          WnckClientResourceUsage client_usage;
+          XResType *types;
+          int n_types;
+          unsigned long pixmap_bytes;
+          XID base;
+
+          memset (&client_usage, '\0', sizeof (client_usage));
+
+          base = clients[i].resource_base & ~clients[i].resource_mask;
+
+          types = NULL;
+          n_types = 0;
+          pixmap_bytes = 0;
+
+          if (!XResQueryClientResources (xdisplay, base, &n_types, &types))
+            continue;
+          XResQueryClientPixmapBytes (xdisplay, base, &pixmap_bytes);
+
+          client_usage.xid = base;
+          client_usage.pid = GPOINTER_TO_UINT (g_hash_table_lookup (client_pids,
+                                                                    GUINT_TO_POINTER (base)));
+          wnck_resource_usage_fill (gdisplay, &client_usage.usage,
+                                    types, n_types, pixmap_bytes);
+
+          if (types)
+            XFree (types);
+
+          g_array_append_val (usages, client_usage);
+        }
+    }
+
+  _wnck_error_trap_pop (xdisplay);
+
+  g_hash_table_destroy (client_pids);
+
+  if (clients)
+    XFree (clients);
+ }
+#endif /* HAVE_XRES */
+}
+
 static WnckClientType client_type = 0;
 
 /**
@@ -87,6 +87,26 @@ struct _WnckResourceUsage
   unsigned long pad9;
 };
 
+typedef struct _WnckClientResourceUsage WnckClientResourceUsage;
+
+/**
+ * WnckClientResourceUsage:
+ * @xid: the X resource base of the X client.
+ * @pid: the process ID of the X client, or 0 if it is not known.
+ * @usage: the X resource usage of the X client.
+ *
+ * The #WnckClientResourceUsage struct contains the resource usage of an X
+ * client, as returned by wnck_read_resource_usage_all().
+ *
+ * Since: 3.4
+ */
+struct _WnckClientResourceUsage
+{
+  gulong            xid;
+  gulong            pid;
+  WnckResourceUsage usage;
+};
+
 /**
  * WnckClientType:
  * @WNCK_CLIENT_TYPE_APPLICATION: the libwnck user is a normal application.
@@ -114,6 +134,9 @@ void wnck_pid_read_resource_usage (GdkDisplay        *gdk_display,
                                    gulong             pid,
                                    WnckResourceUsage *usage);
 
+void wnck_read_resource_usage_all (GdkDisplay *gdk_display,
+                                   GArray     *usages);
+
 G_END_DECLS
 
 #endif /* WNCK_UTIL_H */
@@ -92,6 +92,10 @@ struct _WnckActionMenuPrivate
   GtkWidget *down_item;
   GtkWidget *workspace_item;
   guint idle_handler;
+
+  /* items of the submenu of workspace_item, reused between updates */
+  GPtrArray *move_to_items;
+  gboolean   move_to_viewport;
 };
 
 enum {
@@ -353,6 +357,11 @@ set_item_text (GtkWidget  *mi,
   GtkLabel *label;
 
   label = GTK_LABEL (gtk_bin_get_child (GTK_BIN (mi)));
+
+  if (g_strcmp0 (gtk_label_get_label (label), text) == 0 &&
+      gtk_label_get_use_underline (label))
+    return;
+
   gtk_label_set_text (label, text);
   gtk_label_set_use_underline (label, TRUE);
 }
@@ -380,6 +389,15 @@ set_item_stock (GtkWidget  *mi,
     }
   else
     {
+      gchar *current_stock_id;
+
+      if (gtk_image_get_storage_type (GTK_IMAGE (image)) == GTK_IMAGE_STOCK)
+        {
+          gtk_image_get_stock (GTK_IMAGE (image), &current_stock_id, NULL);
+          if (g_strcmp0 (current_stock_id, stock_id) == 0)
+            return;
+        }
+
       gtk_image_set_from_stock (GTK_IMAGE (image), stock_id,
                                 GTK_ICON_SIZE_MENU);
     }
@@ -794,26 +812,82 @@ get_workspace_name_with_accel (WnckWindow *window,
   }
 }
 
+/* The items of the workspace submenu are kept between updates: an update
+ * only adds or removes the items needed, and changes labels and sensitivity
+ * that are not up to date. */
+static GtkWidget *
+get_move_to_item (WnckActionMenu *menu,
+                  guint           index)
+{
+  GtkWidget *submenu;
+  GtkWidget *item;
+
+  if (index < menu->priv->move_to_items->len)
+    return g_ptr_array_index (menu->priv->move_to_items, index);
+
+  g_assert (index == menu->priv->move_to_items->len);
+
+  submenu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (menu->priv->workspace_item));
+
+  item = make_menu_item (MOVE_TO_WORKSPACE);
+  gtk_menu_shell_append (GTK_MENU_SHELL (submenu), item);
+  set_item_stock (item, NULL);
+
+  g_ptr_array_add (menu->priv->move_to_items, item);
+
+  return item;
+}
+
+static gboolean
+trim_move_to_items (WnckActionMenu *menu,
+                    guint           n_items)
+{
+  GPtrArray *items;
+  guint      i;
+
+  items = menu->priv->move_to_items;
+
+  if (items->len <= n_items)
+    return FALSE;
+
+  for (i = n_items; i < items->len; i++)
+    gtk_widget_destroy (g_ptr_array_index (items, i));
+  g_ptr_array_set_size (items, n_items);
+
+  return TRUE;
+}
+
+static void
+set_move_to_viewport (WnckActionMenu *menu,
+                      gboolean        viewport_mode)
+{
+  if (menu->priv->move_to_viewport == viewport_mode)
+    return;
+
+  /* the items are labelled differently for viewports */
+  trim_move_to_items (menu, 0);
+  menu->priv->move_to_viewport = viewport_mode;
+}
+
 static void
 refill_submenu_workspace (WnckActionMenu *menu)
 {
   GtkWidget *submenu;
-  GList *children;
-  GList *l;
+  WnckScreen *screen;
   int num_workspaces, window_space, i;
+  guint old_n_items;
+  gboolean changed;
   WnckWorkspace *workspace;
 
   submenu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (menu->priv->workspace_item));
 
-  /* Remove existing items */
-  children = gtk_container_get_children (GTK_CONTAINER (submenu));
-  for (l = children; l; l = l->next)
-    gtk_container_remove (GTK_CONTAINER (submenu), l->data);
-  g_list_free (children);
+  set_move_to_viewport (menu, FALSE);
+  old_n_items = menu->priv->move_to_items->len;
 
+  screen = wnck_window_get_screen (menu->priv->window);
   workspace = wnck_window_get_workspace (menu->priv->window);
 
-  num_workspaces = wnck_screen_get_workspace_count (wnck_window_get_screen (menu->priv->window));
+  num_workspaces = wnck_screen_get_workspace_count (screen);
 
   if (workspace)
     window_space = wnck_workspace_get_number (workspace);
@@ -822,33 +896,43 @@ refill_submenu_workspace (WnckActionMenu *menu)
 
   for (i = 0; i < num_workspaces; i++)
     {
-      char      *name;
-      GtkWidget *item;
+      const char *name;
+      const char *item_name;
+      GtkWidget  *item;
 
-      name = get_workspace_name_with_accel (menu->priv->window, i);
-
-      item = make_menu_item (MOVE_TO_WORKSPACE);
+      item = get_move_to_item (menu, i);
       g_object_set_data (G_OBJECT (item), "workspace", GINT_TO_POINTER (i));
 
-      if (i == window_space)
-        gtk_widget_set_sensitive (item, FALSE);
+      /* only build the label again if the workspace name changed */
+      name = wnck_workspace_get_name (wnck_screen_get_workspace (screen, i));
+      item_name = g_object_get_data (G_OBJECT (item), "workspace-name");
+
+      if (g_strcmp0 (name, item_name) != 0)
+        {
+          char *label;
+
+          label = get_workspace_name_with_accel (menu->priv->window, i);
+          set_item_text (item, label);
+          g_free (label);
 
-      gtk_menu_shell_append (GTK_MENU_SHELL (submenu), item);
-      set_item_text (item, name);
-      set_item_stock (item, NULL);
+          g_object_set_data_full (G_OBJECT (item), "workspace-name",
+                                  g_strdup (name), g_free);
+        }
 
-      g_free (name);
+      gtk_widget_set_sensitive (item, i != window_space);
     }
 
-  gtk_menu_reposition (GTK_MENU (submenu));
+  changed = trim_move_to_items (menu, num_workspaces);
+  changed = changed || old_n_items != menu->priv->move_to_items->len;
+
+  if (changed)
+    gtk_menu_reposition (GTK_MENU (submenu));
 }
 
 static void
 refill_submenu_viewport (WnckActionMenu *menu)
 {
   GtkWidget *submenu;
-  GList *children;
-  GList *l;
   WnckScreen *screen;
   WnckWorkspace *workspace;
   int window_x, window_y;
@@ -857,14 +941,13 @@ refill_submenu_viewport (WnckActionMenu *menu)
   int screen_width, screen_height;
   int x, y;
   int number;
+  guint old_n_items;
+  gboolean changed;
 
   submenu = gtk_menu_item_get_submenu (GTK_MENU_ITEM (menu->priv->workspace_item));
 
-  /* Remove existing items */
-  children = gtk_container_get_children (GTK_CONTAINER (submenu));
-  for (l = children; l; l = l->next)
-    gtk_container_remove (GTK_CONTAINER (submenu), l->data);
-  g_list_free (children);
+  set_move_to_viewport (menu, TRUE);
+  old_n_items = menu->priv->move_to_items->len;
 
   screen = wnck_window_get_screen (menu->priv->window);
   workspace = wnck_screen_get_workspace (screen, 0);
@@ -892,35 +975,46 @@ refill_submenu_viewport (WnckActionMenu *menu)
 
       for (x = 0; x < viewport_width; x += screen_width)
         {
-          /* Keep this in sync with what is in get_workspace_name_with_accel()
-           */
-          if (number == 10)
-            label = g_strdup_printf (_("Workspace 1_0"));
-          else
-            label = g_strdup_printf (_("Workspace %s%d"),
-                                     number < 10 ? "_" : "",
-                                     number);
+          gboolean new_item;
+
+          new_item = number - 1 >= (int) menu->priv->move_to_items->len;
+          item = get_move_to_item (menu, number - 1);
+
+          /* the label only depends on the number, so it is set once */
+          if (new_item)
+            {
+              /* Keep this in sync with what is in
+               * get_workspace_name_with_accel() */
+              if (number == 10)
+                label = g_strdup_printf (_("Workspace 1_0"));
+              else
+                label = g_strdup_printf (_("Workspace %s%d"),
+                                         number < 10 ? "_" : "",
+                                         number);
+              set_item_text (item, label);
+              g_free (label);
+            }
+
           number++;
 
-          item = make_menu_item (MOVE_TO_WORKSPACE);
           g_object_set_data (G_OBJECT (item), "viewport_x",
                              GINT_TO_POINTER (x));
           g_object_set_data (G_OBJECT (item), "viewport_y",
                              GINT_TO_POINTER (y));
 
-          if (window_x >= x && window_x < x + screen_width &&
-              window_y >= y && window_y < y + screen_height)
-            gtk_widget_set_sensitive (item, FALSE);
-
-          gtk_menu_shell_append (GTK_MENU_SHELL (submenu), item);
-          set_item_text (item, label);
-          set_item_stock (item, NULL);
-
-          g_free (label);
+          gtk_widget_set_sensitive (item,
+                                    !(window_x >= x &&
+                                      window_x < x + screen_width &&
+                                      window_y >= y &&
+                                      window_y < y + screen_height));
         }
     }
 
-  gtk_menu_reposition (GTK_MENU (submenu));
+  changed = trim_move_to_items (menu, number - 1);
+  changed = changed || old_n_items != menu->priv->move_to_items->len;
+
+  if (changed)
+    gtk_menu_reposition (GTK_MENU (submenu));
 }
 
 static void
@@ -994,6 +1088,9 @@ wnck_action_menu_init (WnckActionMenu *menu)
   menu->priv->down_item = NULL;
   menu->priv->workspace_item = NULL;
   menu->priv->idle_handler = 0;
+
+  menu->priv->move_to_items = g_ptr_array_new ();
+  menu->priv->move_to_viewport = FALSE;
 }
 
 static GObject *
@@ -1196,6 +1293,10 @@ wnck_action_menu_finalize (GObject *object)
     g_source_remove (menu->priv->idle_handler);
   menu->priv->idle_handler = 0;
 
+  /* the items themselves belong to the submenu */
+  g_ptr_array_free (menu->priv->move_to_items, TRUE);
+  menu->priv->move_to_items = NULL;
+
   G_OBJECT_CLASS (wnck_action_menu_parent_class)->finalize (object);
 }
 
@@ -144,6 +144,15 @@ struct _WnckWindowPrivate
   /* idle handler for updates */
   guint update_handler;
 
+  /* the names are read at most at the rate set on the screen: this is the
+   * time of the last read, and the timeout for the pending one */
+  gint64 names_read_time;
+  guint names_throttle;
+
+  /* the properties the names were last read from */
+  _WnckNameProperty name_property;
+  _WnckNameProperty icon_name_property;
+
   /* if you add flags, be sure to set them
    * when we create the window so we get an initial update
    */
@@ -162,6 +171,7 @@ struct _WnckWindowPrivate
 
   guint need_emit_name_changed : 1;
   guint need_emit_icon_changed : 1;
+  guint need_emit_class_changed : 1;
 };
 
 G_DEFINE_TYPE (WnckWindow, wnck_window, G_TYPE_OBJECT);
@@ -174,6 +184,7 @@ enum {
   ICON_CHANGED,
   ACTIONS_CHANGED,
   GEOMETRY_CHANGED,
+  CLASS_CHANGED,
   LAST_SIGNAL
 };
 
@@ -191,6 +202,10 @@ static void emit_actions_changed   (WnckWindow       *window,
                                     WnckWindowActions changed_mask,
                                     WnckWindowActions new_actions);
 static void emit_geometry_changed  (WnckWindow      *window);
+static void emit_class_changed     (WnckWindow      *window);
+
+static void queue_names_update (WnckWindow *window);
+static void unqueue_names_update (WnckWindow *window);
 
 static void update_name      (WnckWindow *window);
 static void update_state     (WnckWindow *window);
@@ -291,6 +306,12 @@ wnck_window_init (WnckWindow *window)
 
   window->priv->update_handler = 0;
 
+  window->priv->names_read_time = 0;
+  window->priv->names_throttle = 0;
+
+  window->priv->name_property = WNCK_NAME_PROPERTY_UNKNOWN;
+  window->priv->icon_name_property = WNCK_NAME_PROPERTY_UNKNOWN;
+
   window->priv->need_update_name = FALSE;
   window->priv->need_update_state = FALSE;
   window->priv->need_update_wm_state = FALSE;
@@ -306,6 +327,7 @@ wnck_window_init (WnckWindow *window)
 
   window->priv->need_emit_name_changed = FALSE;
   window->priv->need_emit_icon_changed = FALSE;
+  window->priv->need_emit_class_changed = FALSE;
 }
 
 static void
@@ -419,6 +441,24 @@ wnck_window_class_init (WnckWindowClass *klass)
                   NULL, NULL,
                   g_cclosure_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
+
+  /**
+   * WnckWindow::class-changed:
+   * @window: the #WnckWindow which emitted the signal.
+   *
+   * Emitted when the class name or the class instance name of @window
+   * changes.
+   *
+   * Since: 3.4
+   */
+  signals[CLASS_CHANGED] =
+    g_signal_new ("class_changed",
+                  G_OBJECT_CLASS_TYPE (object_class),
+                  G_SIGNAL_RUN_LAST,
+                  G_STRUCT_OFFSET (WnckWindowClass, class_changed),
+                  NULL, NULL,
+                  g_cclosure_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
 }
 
 static void
@@ -434,6 +474,7 @@ wnck_window_finalize (GObject *object)
                       FALSE);
 
   unqueue_update (window);
+  unqueue_names_update (window);
 
   if (window->priv->app)
     g_object_unref (G_OBJECT (window->priv->app));
@@ -512,6 +553,13 @@ wnck_window_get_screen (WnckWindow *window)
   return window->priv->screen;
 }
 
+static gboolean
+window_is_interested (WnckWindow         *window,
+                      WnckScreenInterest  interest)
+{
+  return (wnck_screen_get_interest (window->priv->screen) & interest) != 0;
+}
+
 WnckWindow*
 _wnck_window_create (Window      xwindow,
                      WnckScreen *screen,
@@ -570,18 +618,22 @@ _wnck_window_create (Window      xwindow,
 
   window->priv->sort_order = sort_order;
 
-  window->priv->need_update_name = TRUE;
+  window->priv->need_update_name =
+    window_is_interested (window, WNCK_SCREEN_INTEREST_NAMES);
   window->priv->need_update_state = TRUE;
-  window->priv->need_update_icon_name = TRUE;
+  window->priv->need_update_icon_name =
+    window_is_interested (window, WNCK_SCREEN_INTEREST_ICON_NAMES);
   window->priv->need_update_wm_state = TRUE;
   window->priv->need_update_workspace = TRUE;
-  window->priv->need_update_actions = TRUE;
+  window->priv->need_update_actions =
+    window_is_interested (window, WNCK_SCREEN_INTEREST_ACTIONS);
   window->priv->need_update_wintype = TRUE;
   window->priv->need_update_transient_for = TRUE;
   window->priv->need_update_startup_id = TRUE;
   window->priv->need_update_wmclass = TRUE;
   window->priv->need_update_wmhints = TRUE;
-  window->priv->need_update_frame_extents = TRUE;
+  window->priv->need_update_frame_extents =
+    window_is_interested (window, WNCK_SCREEN_INTEREST_FRAME_EXTENTS);
   window->priv->need_emit_name_changed = FALSE;
   window->priv->need_emit_icon_changed = FALSE;
   force_update_now (window);
@@ -1015,7 +1067,7 @@ wnck_window_set_window_type (WnckWindow *window, WnckWindowType wintype)
 
   display = _wnck_window_get_display (window);
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
 
   XChangeProperty (display,
                    window->priv->xwindow,
@@ -1023,7 +1075,7 @@ wnck_window_set_window_type (WnckWindow *window, WnckWindowType wintype)
 		   XA_ATOM, 32, PropModeReplace,
 		   (guchar *)&atom, 1);
 
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 /**
@@ -2134,7 +2186,10 @@ get_icons (WnckWindow *window)
                         DEFAULT_MINI_ICON_WIDTH,
                         DEFAULT_MINI_ICON_HEIGHT))
     {
-      window->priv->need_emit_icon_changed = TRUE;
+      /* the icons are only read on demand when they are not followed: the
+       * caller already gets the new icon */
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_ICONS))
+        window->priv->need_emit_icon_changed = TRUE;
 
       if (window->priv->icon)
         g_object_unref (G_OBJECT (window->priv->icon));
@@ -2416,6 +2471,10 @@ wnck_window_is_visible_on_workspace (WnckWindow    *window,
  *
  * Sets the icon geometry for @window. A typical use case for this is the
  * destination of the minimization animation of @window.
+ *
+ * Nothing is sent to the X server if the icon geometry did not change. The
+ * change is not flushed to the X server either, so that setting the icon
+ * geometry of many #WnckWindow at once results in only one flush.
  */
 void
 wnck_window_set_icon_geometry (WnckWindow *window,
@@ -2503,6 +2562,71 @@ wnck_window_is_in_viewport (WnckWindow    *window,
   return gdk_rectangle_intersect (&viewport_rect, &window_rect, &window_rect);
 }
 
+/**
+ * WnckWindowBatch:
+ *
+ * The #WnckWindowBatch struct is an opaque structure, used to send many
+ * requests to the window manager at once. See wnck_window_batch_begin().
+ *
+ * Since: 3.4
+ */
+struct _WnckWindowBatch
+{
+  WnckScreen *screen;
+};
+
+/**
+ * wnck_window_batch_begin:
+ * @screen: a #WnckScreen.
+ *
+ * Starts a batch of requests to the window manager. Until
+ * wnck_window_batch_commit() is called, the requests made with functions like
+ * wnck_window_minimize(), wnck_window_maximize() or wnck_window_close() on
+ * windows of @screen are queued, instead of each of them waiting for the X
+ * server to process it. This is useful when acting on many windows at once,
+ * since the whole batch then only costs one round trip to the X server.
+ *
+ * The batch must be committed before returning to the main loop.
+ *
+ * Return value: a new #WnckWindowBatch, to pass to wnck_window_batch_commit().
+ *
+ * Since: 3.4
+ **/
+WnckWindowBatch *
+wnck_window_batch_begin (WnckScreen *screen)
+{
+  WnckWindowBatch *batch;
+
+  g_return_val_if_fail (WNCK_IS_SCREEN (screen), NULL);
+
+  batch = g_slice_new (WnckWindowBatch);
+  batch->screen = g_object_ref (screen);
+
+  _wnck_begin_request_batch (DisplayOfScreen (WNCK_SCREEN_XSCREEN (screen)));
+
+  return batch;
+}
+
+/**
+ * wnck_window_batch_commit:
+ * @batch: a #WnckWindowBatch.
+ *
+ * Sends all the requests queued in @batch to the X server, and waits once for
+ * all of them to be processed. @batch is freed and must not be used anymore.
+ *
+ * Since: 3.4
+ **/
+void
+wnck_window_batch_commit (WnckWindowBatch *batch)
+{
+  g_return_if_fail (batch != NULL);
+
+  _wnck_end_request_batch (DisplayOfScreen (WNCK_SCREEN_XSCREEN (batch->screen)));
+
+  g_object_unref (batch->screen);
+  g_slice_free (WnckWindowBatch, batch);
+}
+
 void
 _wnck_window_set_application (WnckWindow      *window,
                               WnckApplication *app)
@@ -2531,6 +2655,36 @@ _wnck_window_set_class_group (WnckWindow     *window,
   window->priv->class_group = class_group;
 }
 
+/* Returns whether a change of one of the (icon) name properties can change
+ * the name, and updates the property the name should be read from.
+ */
+static gboolean
+name_property_changed (_WnckNameProperty *property,
+                       XPropertyEvent    *event,
+                       gboolean           icon_name)
+{
+  _WnckNameProperty changed;
+
+  if (*property == WNCK_NAME_PROPERTY_UNKNOWN)
+    return TRUE;
+
+  changed = _wnck_name_property_from_atom (event->atom, icon_name);
+
+  /* the name does not come from a less preferred property */
+  if (changed > *property)
+    return FALSE;
+
+  if (event->state == PropertyDelete)
+    {
+      if (changed == *property)
+        *property = WNCK_NAME_PROPERTY_UNKNOWN;
+    }
+  else
+    *property = changed;
+
+  return TRUE;
+}
+
 void
 _wnck_window_process_property_notify (WnckWindow *window,
                                       XEvent     *xevent)
@@ -2554,8 +2708,13 @@ _wnck_window_process_property_notify (WnckWindow *window,
            xevent->xproperty.atom ==
            _wnck_atom_get ("_NET_WM_VISIBLE_NAME"))
     {
-      window->priv->need_update_name = TRUE;
-      queue_update (window);
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_NAMES) &&
+          name_property_changed (&window->priv->name_property,
+                                 &xevent->xproperty, FALSE))
+        {
+          window->priv->need_update_name = TRUE;
+          queue_names_update (window);
+        }
     }
   else if (xevent->xproperty.atom ==
            XA_WM_ICON_NAME ||
@@ -2564,14 +2723,22 @@ _wnck_window_process_property_notify (WnckWindow *window,
            xevent->xproperty.atom ==
            _wnck_atom_get ("_NET_WM_VISIBLE_ICON_NAME"))
     {
-      window->priv->need_update_icon_name = TRUE;
-      queue_update (window);
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_ICON_NAMES) &&
+          name_property_changed (&window->priv->icon_name_property,
+                                 &xevent->xproperty, TRUE))
+        {
+          window->priv->need_update_icon_name = TRUE;
+          queue_names_update (window);
+        }
     }
   else if (xevent->xproperty.atom ==
            _wnck_atom_get ("_NET_WM_ALLOWED_ACTIONS"))
     {
-      window->priv->need_update_actions = TRUE;
-      queue_update (window);
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_ACTIONS))
+        {
+          window->priv->need_update_actions = TRUE;
+          queue_update (window);
+        }
     }
   else if (xevent->xproperty.atom ==
            _wnck_atom_get ("_NET_WM_DESKTOP"))
@@ -2608,9 +2775,12 @@ _wnck_window_process_property_notify (WnckWindow *window,
            xevent->xproperty.atom ==
            _wnck_atom_get ("KWM_WIN_ICON"))
     {
+      /* the icons are read again when needed, even if we are not
+       * interested in following them */
       _wnck_icon_cache_property_changed (window->priv->icon_cache,
                                          xevent->xproperty.atom);
-      queue_update (window);
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_ICONS))
+        queue_update (window);
     }
   else if (xevent->xproperty.atom ==
   	   _wnck_atom_get ("WM_HINTS"))
@@ -2621,9 +2791,38 @@ _wnck_window_process_property_notify (WnckWindow *window,
   else if (xevent->xproperty.atom ==
            _wnck_atom_get ("_NET_FRAME_EXTENTS"))
     {
-      window->priv->need_update_frame_extents = TRUE;
-      queue_update (window);
+      if (window_is_interested (window, WNCK_SCREEN_INTEREST_FRAME_EXTENTS))
+        {
+          window->priv->need_update_frame_extents = TRUE;
+          queue_update (window);
+        }
+    }
+}
+
+void
+_wnck_window_interest_added (WnckWindow         *window,
+                             WnckScreenInterest  added)
+{
+  g_return_if_fail (WNCK_IS_WINDOW (window));
+
+  /* the name properties changed without us following them */
+  if (added & WNCK_SCREEN_INTEREST_NAMES)
+    {
+      window->priv->need_update_name = TRUE;
+      window->priv->name_property = WNCK_NAME_PROPERTY_UNKNOWN;
     }
+  if (added & WNCK_SCREEN_INTEREST_ICON_NAMES)
+    {
+      window->priv->need_update_icon_name = TRUE;
+      window->priv->icon_name_property = WNCK_NAME_PROPERTY_UNKNOWN;
+    }
+  if (added & WNCK_SCREEN_INTEREST_ACTIONS)
+    window->priv->need_update_actions = TRUE;
+  if (added & WNCK_SCREEN_INTEREST_FRAME_EXTENTS)
+    window->priv->need_update_frame_extents = TRUE;
+
+  /* the icons are read in the update if they changed in the meantime */
+  queue_update (window);
 }
 
 void
@@ -2815,18 +3014,78 @@ update_state (WnckWindow *window)
     }
 }
 
+static gboolean
+names_throttle_timeout (gpointer data)
+{
+  WnckWindow *window = WNCK_WINDOW (data);
+
+  window->priv->names_throttle = 0;
+  queue_update (window);
+
+  return FALSE;
+}
+
+/* Windows like terminals can change their title many times per second.
+ * The first change after a quiet period is read right away, and the
+ * following ones are coalesced so that the names are read at most at the
+ * rate set with wnck_screen_set_name_rate_limit(); the last value is always
+ * read, when the pending timeout fires.
+ */
+static void
+queue_names_update (WnckWindow *window)
+{
+  guint rate;
+  gint64 now;
+  gint64 next;
+
+  if (window->priv->names_throttle != 0)
+    return;
+
+  rate = wnck_screen_get_name_rate_limit (window->priv->screen);
+  if (rate == 0)
+    {
+      queue_update (window);
+      return;
+    }
+
+  now = g_get_monotonic_time ();
+  next = window->priv->names_read_time + G_USEC_PER_SEC / rate;
+
+  if (now >= next)
+    {
+      queue_update (window);
+      return;
+    }
+
+  window->priv->names_throttle =
+    g_timeout_add ((next - now + 999) / 1000, names_throttle_timeout, window);
+}
+
+static void
+unqueue_names_update (WnckWindow *window)
+{
+  if (window->priv->names_throttle != 0)
+    {
+      g_source_remove (window->priv->names_throttle);
+      window->priv->names_throttle = 0;
+    }
+}
+
 static void
 update_name (WnckWindow *window)
 {
   char *new_name;
 
-  if (!window->priv->need_update_name)
+  /* keep the update for when the throttle timeout fires */
+  if (!window->priv->need_update_name || window->priv->names_throttle != 0)
     return;
 
   window->priv->need_update_name = FALSE;
+  window->priv->names_read_time = g_get_monotonic_time ();
 
-  new_name = _wnck_get_name (WNCK_SCREEN_XSCREEN (window->priv->screen),
-                             window->priv->xwindow);
+  new_name = _wnck_get_name_from (WNCK_SCREEN_XSCREEN (window->priv->screen),
+                                  window->priv->xwindow,
+                                  &window->priv->name_property);
 
   if (g_strcmp0 (window->priv->name, new_name) != 0)
     window->priv->need_emit_name_changed = TRUE;
@@ -2840,13 +3099,16 @@ update_icon_name (WnckWindow *window)
 {
   char *new_name = NULL;
 
-  if (!window->priv->need_update_icon_name)
+  if (!window->priv->need_update_icon_name ||
+      window->priv->names_throttle != 0)
     return;
 
   window->priv->need_update_icon_name = FALSE;
+  window->priv->names_read_time = g_get_monotonic_time ();
 
-  new_name = _wnck_get_icon_name (WNCK_SCREEN_XSCREEN (window->priv->screen),
-                                  window->priv->xwindow);
+  new_name = _wnck_get_icon_name_from (WNCK_SCREEN_XSCREEN (window->priv->screen),
+                                       window->priv->xwindow,
+                                       &window->priv->icon_name_property);
 
   if (g_strcmp0 (window->priv->icon_name, new_name) != 0)
     window->priv->need_emit_name_changed = TRUE;
@@ -3110,13 +3372,16 @@ update_startup_id (WnckWindow *window)
 static void
 update_wmclass (WnckWindow *window)
 {
+  char *old_res_class;
+  char *old_res_name;
+
   if (!window->priv->need_update_wmclass)
     return;
 
   window->priv->need_update_wmclass = FALSE;
 
-  g_free (window->priv->res_class);
-  g_free (window->priv->res_name);
+  old_res_class = window->priv->res_class;
+  old_res_name = window->priv->res_name;
 
   window->priv->res_class = NULL;
   window->priv->res_name = NULL;
@@ -3125,6 +3390,13 @@ update_wmclass (WnckWindow *window)
                      window->priv->xwindow,
                      &window->priv->res_class,
                      &window->priv->res_name);
+
+  if (g_strcmp0 (old_res_class, window->priv->res_class) != 0 ||
+      g_strcmp0 (old_res_name, window->priv->res_name) != 0)
+    window->priv->need_emit_class_changed = TRUE;
+
+  g_free (old_res_class);
+  g_free (old_res_name);
 }
 
 static void
@@ -3238,7 +3510,8 @@ force_update_now (WnckWindow *window)
   update_actions (window);
   update_frame_extents (window); /* emits signals */
 
-  get_icons (window);
+  if (window_is_interested (window, WNCK_SCREEN_INTEREST_ICONS))
+    get_icons (window);
 
   new_state = COMPRESS_STATE (window);
 
@@ -3251,6 +3524,9 @@ force_update_now (WnckWindow *window)
 
   if (window->priv->need_emit_icon_changed)
     emit_icon_changed (window);
+
+  if (window->priv->need_emit_class_changed)
+    emit_class_changed (window);
 }
 
 
@@ -3336,3 +3612,12 @@ emit_geometry_changed (WnckWindow *window)
                  signals[GEOMETRY_CHANGED],
                  0);
 }
+
+static void
+emit_class_changed (WnckWindow *window)
+{
+  window->priv->need_emit_class_changed = FALSE;
+  g_signal_emit (G_OBJECT (window),
+                 signals[CLASS_CHANGED],
+                 0);
+}
@@ -234,6 +234,7 @@ typedef enum
 
 typedef struct _WnckWindowClass   WnckWindowClass;
 typedef struct _WnckWindowPrivate WnckWindowPrivate;
+typedef struct _WnckWindowBatch   WnckWindowBatch;
 
 /**
  * WnckWindow:
@@ -275,9 +276,11 @@ struct _WnckWindowClass
 
   /* Changed size/position */
   void (* geometry_changed)      (WnckWindow       *window);
-  
+
+  /* Changed class name or class instance name */
+  void (* class_changed)         (WnckWindow       *window);
+
   /* Padding for future expansion */
-  void (* pad1) (void);
   void (* pad2) (void);
   void (* pad3) (void);
   void (* pad4) (void);
@@ -414,6 +417,9 @@ gboolean wnck_window_is_on_workspace         (WnckWindow    *window,
 gboolean wnck_window_is_in_viewport          (WnckWindow    *window,
                                               WnckWorkspace *workspace);
 
+WnckWindowBatch *wnck_window_batch_begin  (WnckScreen      *screen);
+void             wnck_window_batch_commit (WnckWindowBatch *batch);
+
 G_END_DECLS
 
 #endif /* WNCK_WINDOW_H */
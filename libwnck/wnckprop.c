@@ -928,11 +928,15 @@ update_window (WnckWindow *window)
 {
   WnckWindowActions        actions;
   WnckWindowMoveResizeMask geometry_mask;
+  WnckWindowBatch         *batch;
   unsigned int             timestamp;
 
   actions = wnck_window_get_actions (window);
   timestamp = get_xserver_timestamp (wnck_window_get_screen (window));
 
+  /* send all the requests at once */
+  batch = wnck_window_batch_begin (wnck_window_get_screen (window));
+
 #define SET_PROPERTY(name, action)                                      \
   if (set_##name)                                                       \
     {                                                                   \
@@ -1082,6 +1086,8 @@ update_window (WnckWindow *window)
   #define wnck_window_keyboard_resize wnck_window_keyboard_size
   SET_PROPERTY (keyboard_resize, WNCK_WINDOW_ACTION_RESIZE)
   SET_PROPERTY_TIMESTAMP (close, WNCK_WINDOW_ACTION_CLOSE)
+
+  wnck_window_batch_commit (batch);
 }
 
 static void
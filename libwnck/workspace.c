@@ -440,25 +440,14 @@ wnck_workspace_is_virtual (WnckWorkspace *space)
 int
 wnck_workspace_get_layout_row (WnckWorkspace *space)
 {
-  _WnckLayoutOrientation orientation;
-  _WnckLayoutCorner corner;
-  int n_rows;
-  int n_cols;
   int row;
 
   g_return_val_if_fail (WNCK_IS_WORKSPACE (space), -1);
 
-  _wnck_screen_get_workspace_layout (space->priv->screen,
-                                     &orientation, &n_rows, &n_cols, &corner);
-
-  if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-    row = space->priv->number / n_cols;
-  else
-    row = space->priv->number % n_rows;
-
-  if (corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT ||
-      corner == WNCK_LAYOUT_CORNER_BOTTOMLEFT)
-    row = n_rows - row;
+  if (!_wnck_screen_get_workspace_layout_position (space->priv->screen,
+                                                   space->priv->number,
+                                                   &row, NULL))
+    return -1;
 
   return row;
 }
@@ -480,25 +469,14 @@ wnck_workspace_get_layout_row (WnckWorkspace *space)
 int
 wnck_workspace_get_layout_column (WnckWorkspace *space)
 {
-  _WnckLayoutOrientation orientation;
-  _WnckLayoutCorner corner;
-  int n_rows;
-  int n_cols;
   int col;
 
   g_return_val_if_fail (WNCK_IS_WORKSPACE (space), -1);
 
-  _wnck_screen_get_workspace_layout (space->priv->screen,
-                                     &orientation, &n_rows, &n_cols, &corner);
-
-  if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-    col = space->priv->number % n_cols;
-  else
-    col = space->priv->number / n_rows;
-
-  if (corner == WNCK_LAYOUT_CORNER_TOPRIGHT ||
-      corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT)
-    col = n_cols - col;
+  if (!_wnck_screen_get_workspace_layout_position (space->priv->screen,
+                                                   space->priv->number,
+                                                   NULL, &col))
+    return -1;
 
   return col;
 }
@@ -521,93 +499,38 @@ WnckWorkspace*
 wnck_workspace_get_neighbor (WnckWorkspace       *space,
                              WnckMotionDirection  direction)
 {
-  _WnckLayoutOrientation orientation;
-  _WnckLayoutCorner corner;
-  int n_rows;
-  int n_cols;
   int row;
   int col;
-  int add;
   int index;
 
   g_return_val_if_fail (WNCK_IS_WORKSPACE (space), NULL);
 
-  _wnck_screen_get_workspace_layout (space->priv->screen,
-                                     &orientation, &n_rows, &n_cols, &corner);
-
-  row = wnck_workspace_get_layout_row (space);
-  col = wnck_workspace_get_layout_column (space);
-
-  index = space->priv->number;
+  if (!_wnck_screen_get_workspace_layout_position (space->priv->screen,
+                                                   space->priv->number,
+                                                   &row, &col))
+    return NULL;
 
   switch (direction)
     {
     case WNCK_MOTION_LEFT:
-      if (col == 0)
-        return NULL;
-
-      if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-        add = 1;
-      else
-        add = n_rows;
-
-      if (corner == WNCK_LAYOUT_CORNER_TOPRIGHT ||
-          corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT)
-        index += add;
-      else
-        index -= add;
+      col--;
       break;
-
     case WNCK_MOTION_RIGHT:
-      if (col == n_cols - 1)
-        return NULL;
-
-      if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-        add = 1;
-      else
-        add = n_rows;
-
-      if (corner == WNCK_LAYOUT_CORNER_TOPRIGHT ||
-          corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT)
-        index -= add;
-      else
-        index += add;
+      col++;
       break;
-
     case WNCK_MOTION_UP:
-      if (row == 0)
-        return NULL;
-
-      if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-        add = n_cols;
-      else
-        add = 1;
-
-      if (corner == WNCK_LAYOUT_CORNER_BOTTOMLEFT ||
-          corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT)
-        index += add;
-      else
-        index -= add;
+      row--;
       break;
-
     case WNCK_MOTION_DOWN:
-      if (row == n_rows - 1)
-        return NULL;
-
-      if (orientation == WNCK_LAYOUT_ORIENTATION_HORIZONTAL)
-        add = n_cols;
-      else
-        add = 1;
-
-      if (corner == WNCK_LAYOUT_CORNER_BOTTOMLEFT ||
-          corner == WNCK_LAYOUT_CORNER_BOTTOMRIGHT)
-        index -= add;
-      else
-        index += add;
+      row++;
       break;
+    default:
+      return NULL;
     }
 
-  if (index == space->priv->number)
+  index = _wnck_screen_get_workspace_at_layout_position (space->priv->screen,
+                                                         row, col);
+  if (index < 0)
     return NULL;
 
   return wnck_screen_get_workspace (space->priv->screen, index);
@@ -25,7 +25,12 @@
 #include "xutils.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <cairo-xlib.h>
+#ifdef HAVE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif
 #include "screen.h"
 #include "window.h"
 #include "private.h"
@@ -287,19 +292,15 @@ text_property_to_utf8 (Display             *display,
   return retval;
 }
 
-char*
-_wnck_get_text_property (Screen *screen,
-                         Window  xwindow,
-                         Atom    atom)
+/* must be called with an error trap pushed */
+static char*
+read_text_property (Display *display,
+                    Window   xwindow,
+                    Atom     atom)
 {
-  Display *display;
   XTextProperty text;
   char *retval;
 
-  display = DisplayOfScreen (screen);
-
-  _wnck_error_trap_push (display);
-
   text.nitems = 0;
   if (XGetTextProperty (display,
                         xwindow,
@@ -316,6 +317,21 @@ _wnck_get_text_property (Screen *screen,
       retval = NULL;
     }
 
+  return retval;
+}
+
+char*
+_wnck_get_text_property (Screen *screen,
+                         Window  xwindow,
+                         Atom    atom)
+{
+  Display *display;
+  char *retval;
+
+  display = DisplayOfScreen (screen);
+
+  _wnck_error_trap_push (display);
+  retval = read_text_property (display, xwindow, atom);
   _wnck_error_trap_pop (display);
 
   return retval;
@@ -363,26 +379,40 @@ _wnck_get_string_property_latin1 (Screen *screen,
   return retval;
 }
 
-char*
-_wnck_get_utf8_property (Screen *screen,
-                         Window  xwindow,
-                         Atom    atom)
+static char*
+utf8_value_dup (Atom        atom,
+                const char *val,
+                gulong      nitems)
+{
+  if (!g_utf8_validate (val, nitems, NULL))
+    {
+      g_warning ("Property %s contained invalid UTF-8\n",
+                 _wnck_atom_name (atom));
+      return NULL;
+    }
+
+  return g_strndup (val, nitems);
+}
+
+/* must be called with an error trap pushed; a failed request makes
+ * XGetWindowProperty() return an error, so the trap only needs to be popped
+ * once all the reads are done */
+static char*
+read_utf8_property (Display *display,
+                    Window   xwindow,
+                    Atom     atom)
 {
-  Display *display;
   Atom type;
   int format;
   gulong nitems;
   gulong bytes_after;
   gchar *val;
-  int err, result;
+  int result;
   char *retval;
   Atom utf8_string;
 
-  display = DisplayOfScreen (screen);
-
   utf8_string = _wnck_atom_get ("UTF8_STRING");
 
-  _wnck_error_trap_push (display);
   type = None;
   val = NULL;
   result = XGetWindowProperty (display,
@@ -392,10 +422,8 @@ _wnck_get_utf8_property (Screen *screen,
 			       False, utf8_string,
 			       &type, &format, &nitems,
 			       &bytes_after, (guchar **)&val);
-  err = _wnck_error_trap_pop (display);
 
-  if (err != Success ||
-      result != Success)
+  if (result != Success)
     return NULL;
 
   if (type != utf8_string ||
@@ -407,18 +435,31 @@ _wnck_get_utf8_property (Screen *screen,
       return NULL;
     }
 
-  if (!g_utf8_validate (val, nitems, NULL))
+  retval = utf8_value_dup (atom, val, nitems);
+
+  XFree (val);
+
+  return retval;
+}
+
+char*
+_wnck_get_utf8_property (Screen *screen,
+                         Window  xwindow,
+                         Atom    atom)
+{
+  Display *display;
+  char *retval;
+
+  display = DisplayOfScreen (screen);
+
+  _wnck_error_trap_push (display);
+  retval = read_utf8_property (display, xwindow, atom);
+  if (_wnck_error_trap_pop (display) != Success)
     {
-      g_warning ("Property %s contained invalid UTF-8\n",
-                 _wnck_atom_name (atom));
-      XFree (val);
+      g_free (retval);
       return NULL;
     }
 
-  retval = g_strndup (val, nitems);
-
-  XFree (val);
-
   return retval;
 }
 
@@ -709,6 +750,15 @@ _wnck_error_trap_pop (Display *display)
   return gdk_error_trap_pop ();
 }
 
+/* Like _wnck_error_trap_pop(), but without waiting for the server: errors
+ * are ignored whenever they arrive, and the requests stay in the output
+ * buffer until the next flush. */
+void
+_wnck_error_trap_pop_ignored (Display *display)
+{
+  gdk_error_trap_pop_ignored ();
+}
+
 static GdkFilterReturn
 filter_func (GdkXEvent  *gdkxevent,
              GdkEvent   *event,
@@ -726,6 +776,9 @@ filter_func (GdkXEvent  *gdkxevent,
       {
         WnckScreen *screen;
 
+        if (_wnck_desktop_layout_manager_process_event (xevent))
+          break;
+
         screen = wnck_screen_get_for_root (xevent->xany.window);
         if (screen != NULL)
           _wnck_screen_process_property_notify (screen, xevent);
@@ -833,6 +886,78 @@ _wnck_xid_hash (gconstpointer v)
 #endif
 }
 
+/* Requests to the window manager are sent without waiting for a reply. The
+ * error trap around each request syncs with the X server, though: when many
+ * requests are sent in a row on a display, they can share a single error
+ * trap, see _wnck_begin_request_batch(). */
+static int
+request_batch_get_depth (Display *display)
+{
+  GdkDisplay *gdkdisplay;
+
+  gdkdisplay = gdk_x11_lookup_xdisplay (display);
+  if (gdkdisplay == NULL)
+    return 0;
+
+  return GPOINTER_TO_INT (g_object_get_data (G_OBJECT (gdkdisplay),
+                                             "wnck-request-batch-depth"));
+}
+
+static void
+request_batch_set_depth (Display *display,
+                         int      depth)
+{
+  GdkDisplay *gdkdisplay;
+
+  gdkdisplay = gdk_x11_lookup_xdisplay (display);
+  g_return_if_fail (gdkdisplay != NULL);
+
+  g_object_set_data (G_OBJECT (gdkdisplay), "wnck-request-batch-depth",
+                     GINT_TO_POINTER (depth));
+}
+
+void
+_wnck_request_trap_push (Display *display)
+{
+  if (request_batch_get_depth (display) == 0)
+    _wnck_error_trap_push (display);
+}
+
+void
+_wnck_request_trap_pop (Display *display)
+{
+  if (request_batch_get_depth (display) == 0)
+    _wnck_error_trap_pop (display);
+}
+
+void
+_wnck_begin_request_batch (Display *display)
+{
+  int depth;
+
+  depth = request_batch_get_depth (display);
+
+  if (depth == 0)
+    _wnck_error_trap_push (display);
+
+  request_batch_set_depth (display, depth + 1);
+}
+
+void
+_wnck_end_request_batch (Display *display)
+{
+  int depth;
+
+  depth = request_batch_get_depth (display);
+
+  g_return_if_fail (depth > 0);
+
+  request_batch_set_depth (display, depth - 1);
+
+  if (depth == 1)
+    _wnck_error_trap_pop (display);
+}
+
 void
 _wnck_iconify (Screen *screen,
                Window  xwindow)
@@ -841,9 +966,9 @@ _wnck_iconify (Screen *screen,
 
   display = DisplayOfScreen (screen);
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XIconifyWindow (display, xwindow, DefaultScreen (display));
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -860,12 +985,12 @@ _wnck_deiconify (Screen *screen,
   display = DisplayOfScreen (screen);
   gdkwindow = _wnck_gdk_window_lookup_from_window (screen, xwindow);
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   if (gdkwindow)
     gdk_window_show (gdkwindow);
   else
     XMapRaised (display, xwindow);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -893,13 +1018,13 @@ _wnck_close (Screen *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
               root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 #define _NET_WM_MOVERESIZE_SIZE_TOPLEFT      0
@@ -938,13 +1063,13 @@ _wnck_keyboard_move (Screen *screen,
   xev.xclient.data.l[3] = 0; /* unused */
   xev.xclient.data.l[4] = _wnck_get_client_type ();
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
               root,
               False,
               SubstructureRedirectMask | SubstructureNotifyMask,
               &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -971,13 +1096,13 @@ _wnck_keyboard_size (Screen *screen,
   xev.xclient.data.l[3] = 0; /* unused */
   xev.xclient.data.l[4] = _wnck_get_client_type ();
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
               root,
               False,
               SubstructureRedirectMask | SubstructureNotifyMask,
               &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1011,13 +1136,13 @@ _wnck_change_state (Screen  *screen,
   xev.xclient.data.l[3] = _wnck_get_client_type ();
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1045,13 +1170,13 @@ _wnck_change_workspace (Screen     *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1083,13 +1208,13 @@ _wnck_activate (Screen *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1117,13 +1242,13 @@ _wnck_activate_workspace (Screen *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1151,13 +1276,13 @@ _wnck_change_viewport (Screen *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -1184,13 +1309,13 @@ _wnck_toggle_showing_desktop (Screen  *screen,
   xev.xclient.data.l[3] = 0;
   xev.xclient.data.l[4] = 0;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
 	      root,
               False,
 	      SubstructureRedirectMask | SubstructureNotifyMask,
 	      &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 char*
@@ -1225,46 +1350,272 @@ _wnck_get_pid (Screen *screen,
     return val;
 }
 
-char*
-_wnck_get_name (Screen *screen,
-                Window  xwindow)
+static char*
+read_name_property (Display           *display,
+                    Window             xwindow,
+                    _WnckNameProperty  property,
+                    const char        *visible_atom,
+                    const char        *net_atom,
+                    Atom               icccm_atom)
+{
+  switch (property)
+    {
+    case WNCK_NAME_PROPERTY_VISIBLE:
+      return read_utf8_property (display, xwindow,
+                                 _wnck_atom_get (visible_atom));
+    case WNCK_NAME_PROPERTY_NET:
+      return read_utf8_property (display, xwindow,
+                                 _wnck_atom_get (net_atom));
+    case WNCK_NAME_PROPERTY_ICCCM:
+      return read_text_property (display, xwindow, icccm_atom);
+    case WNCK_NAME_PROPERTY_UNKNOWN:
+    case WNCK_NAME_PROPERTY_NONE:
+    default:
+      return NULL;
+    }
+}
+
+#ifdef HAVE_XCB
+static char*
+name_from_reply (Display                  *display,
+                 _WnckNameProperty         property,
+                 Atom                      atom,
+                 xcb_get_property_reply_t *reply)
 {
+  XTextProperty text;
+
+  if (reply->type == None)
+    return NULL;
+
+  if (property == WNCK_NAME_PROPERTY_ICCCM)
+    {
+      text.value = xcb_get_property_value (reply);
+      text.encoding = reply->type;
+      text.format = reply->format;
+      text.nitems = reply->value_len;
+
+      return text_property_to_utf8 (display, &text);
+    }
+
+  if (reply->type != _wnck_atom_get ("UTF8_STRING") ||
+      reply->format != 8 ||
+      reply->value_len == 0)
+    return NULL;
+
+  return utf8_value_dup (atom,
+                         xcb_get_property_value (reply),
+                         xcb_get_property_value_length (reply));
+}
+
+/* Requests all the name properties other than skip at once, and takes the
+ * name from the most preferred property holding one, so that looking for
+ * the name costs a single round trip. Errors come back with the replies,
+ * so no error trap is needed.
+ */
+static char*
+read_name_pipelined (Display           *display,
+                     Window             xwindow,
+                     _WnckNameProperty  skip,
+                     _WnckNameProperty *property,
+                     const char        *visible_atom,
+                     const char        *net_atom,
+                     Atom               icccm_atom)
+{
+  xcb_connection_t *connection;
+  xcb_get_property_cookie_t cookies[WNCK_NAME_PROPERTY_NONE];
+  Atom atoms[WNCK_NAME_PROPERTY_NONE];
+  _WnckNameProperty prop;
   char *name;
 
-  name = _wnck_get_utf8_property (screen, xwindow,
-                                  _wnck_atom_get ("_NET_WM_VISIBLE_NAME"));
+  connection = XGetXCBConnection (display);
+
+  atoms[WNCK_NAME_PROPERTY_VISIBLE] = _wnck_atom_get (visible_atom);
+  atoms[WNCK_NAME_PROPERTY_NET] = _wnck_atom_get (net_atom);
+  atoms[WNCK_NAME_PROPERTY_ICCCM] = icccm_atom;
+
+  for (prop = WNCK_NAME_PROPERTY_VISIBLE;
+       prop < WNCK_NAME_PROPERTY_NONE;
+       prop++)
+    {
+      if (prop == skip)
+        continue;
+
+      /* the length is in 32-bit units, keep it from overflowing in bytes */
+      cookies[prop] = xcb_get_property (connection, FALSE, xwindow,
+                                        atoms[prop],
+                                        prop == WNCK_NAME_PROPERTY_ICCCM ?
+                                          XCB_GET_PROPERTY_TYPE_ANY :
+                                          _wnck_atom_get ("UTF8_STRING"),
+                                        0, G_MAXUINT32 / 4);
+    }
+
+  name = NULL;
+
+  for (prop = WNCK_NAME_PROPERTY_VISIBLE;
+       prop < WNCK_NAME_PROPERTY_NONE;
+       prop++)
+    {
+      xcb_get_property_reply_t *reply;
+      xcb_generic_error_t *error;
+
+      if (prop == skip)
+        continue;
+
+      error = NULL;
+      reply = xcb_get_property_reply (connection, cookies[prop], &error);
+      free (error);
+
+      if (reply == NULL)
+        continue;
+
+      name = name_from_reply (display, prop, atoms[prop], reply);
+      free (reply);
+
+      if (name != NULL)
+        break;
+    }
 
-  if (name == NULL)
-    name = _wnck_get_utf8_property (screen, xwindow,
-                                    _wnck_atom_get ("_NET_WM_NAME"));
+  *property = prop;
 
-  if (name == NULL)
-    name = _wnck_get_text_property (screen, xwindow,
-                                    XA_WM_NAME);
+  /* the replies of the less preferred properties are not needed anymore */
+  if (prop < WNCK_NAME_PROPERTY_NONE)
+    for (prop++; prop < WNCK_NAME_PROPERTY_NONE; prop++)
+      if (prop != skip)
+        xcb_discard_reply (connection, cookies[prop].sequence);
 
   return name;
 }
+#endif /* HAVE_XCB */
 
-char*
-_wnck_get_icon_name (Screen *screen,
-                     Window  xwindow)
+/* Reads the name from the property in *property if it is known to hold the
+ * name, and else looks for it in the three properties in order of
+ * preference. With XCB, the three properties are requested at once.
+ */
+static char*
+get_name_with_fallback (Screen            *screen,
+                        Window             xwindow,
+                        _WnckNameProperty *property,
+                        const char        *visible_atom,
+                        const char        *net_atom,
+                        Atom               icccm_atom)
 {
+  Display *display;
+  _WnckNameProperty known;
+  _WnckNameProperty prop;
   char *name;
 
-  name = _wnck_get_utf8_property (screen, xwindow,
-                                  _wnck_atom_get ("_NET_WM_VISIBLE_ICON_NAME"));
+  display = DisplayOfScreen (screen);
+
+  known = property ? *property : WNCK_NAME_PROPERTY_UNKNOWN;
+
+  if (known != WNCK_NAME_PROPERTY_UNKNOWN &&
+      known != WNCK_NAME_PROPERTY_NONE)
+    {
+      /* each read fails on its own if the window is gone, leaving the name
+       * NULL; there is no need to sync to find out */
+      _wnck_error_trap_push (display);
+      name = read_name_property (display, xwindow, known,
+                                 visible_atom, net_atom, icccm_atom);
+      _wnck_error_trap_pop_ignored (display);
+
+      if (name != NULL)
+        return name;
+    }
+
+  /* the property was removed, or was not known: look for the name */
+#ifdef HAVE_XCB
+  name = read_name_pipelined (display, xwindow, known, &prop,
+                              visible_atom, net_atom, icccm_atom);
+#else
+  name = NULL;
 
-  if (name == NULL)
-    name = _wnck_get_utf8_property (screen, xwindow,
-                                    _wnck_atom_get ("_NET_WM_ICON_NAME"));
+  _wnck_error_trap_push (display);
 
-  if (name == NULL)
-    name = _wnck_get_text_property (screen, xwindow,
-                                    XA_WM_ICON_NAME);
+  for (prop = WNCK_NAME_PROPERTY_VISIBLE;
+       prop < WNCK_NAME_PROPERTY_NONE;
+       prop++)
+    {
+      if (prop == known)
+        continue;
+
+      name = read_name_property (display, xwindow, prop,
+                                 visible_atom, net_atom, icccm_atom);
+      if (name != NULL)
+        break;
+    }
+
+  _wnck_error_trap_pop_ignored (display);
+#endif /* HAVE_XCB */
+
+  if (property)
+    *property = prop;
 
   return name;
 }
 
+char*
+_wnck_get_name (Screen *screen,
+                Window  xwindow)
+{
+  return _wnck_get_name_from (screen, xwindow, NULL);
+}
+
+/* Like _wnck_get_name(), but only reads the property in *property when it
+ * still holds a name, instead of trying _NET_WM_VISIBLE_NAME, _NET_WM_NAME
+ * and WM_NAME in turn. *property is set to the property the name was read
+ * from.
+ */
+char*
+_wnck_get_name_from (Screen            *screen,
+                     Window             xwindow,
+                     _WnckNameProperty *property)
+{
+  return get_name_with_fallback (screen, xwindow, property,
+                                 "_NET_WM_VISIBLE_NAME",
+                                 "_NET_WM_NAME",
+                                 XA_WM_NAME);
+}
+
+char*
+_wnck_get_icon_name (Screen *screen,
+                     Window  xwindow)
+{
+  return _wnck_get_icon_name_from (screen, xwindow, NULL);
+}
+
+/* Like _wnck_get_name_from(), for _NET_WM_VISIBLE_ICON_NAME,
+ * _NET_WM_ICON_NAME and WM_ICON_NAME.
+ */
+char*
+_wnck_get_icon_name_from (Screen            *screen,
+                          Window             xwindow,
+                          _WnckNameProperty *property)
+{
+  return get_name_with_fallback (screen, xwindow, property,
+                                 "_NET_WM_VISIBLE_ICON_NAME",
+                                 "_NET_WM_ICON_NAME",
+                                 XA_WM_ICON_NAME);
+}
+
+/* Returns which of the (icon) name properties @atom is, or
+ * WNCK_NAME_PROPERTY_UNKNOWN if it is not one of them.
+ */
+_WnckNameProperty
+_wnck_name_property_from_atom (Atom     atom,
+                               gboolean icon_name)
+{
+  if (atom == _wnck_atom_get (icon_name ? "_NET_WM_VISIBLE_ICON_NAME"
+                                        : "_NET_WM_VISIBLE_NAME"))
+    return WNCK_NAME_PROPERTY_VISIBLE;
+  else if (atom == _wnck_atom_get (icon_name ? "_NET_WM_ICON_NAME"
+                                             : "_NET_WM_NAME"))
+    return WNCK_NAME_PROPERTY_NET;
+  else if (atom == (icon_name ? XA_WM_ICON_NAME : XA_WM_NAME))
+    return WNCK_NAME_PROPERTY_ICCCM;
+  else
+    return WNCK_NAME_PROPERTY_UNKNOWN;
+}
+
 static char*
 latin1_to_utf8 (const char *latin1)
 {
@@ -1725,6 +2076,59 @@ _wnck_gdk_pixbuf_get_from_pixmap (Screen *screen,
   return retval;
 }
 
+/* Like _wnck_gdk_pixbuf_get_from_pixmap(), but the pixmap is scaled down to
+ * fit in max_width x max_height, keeping its aspect ratio. The scaling is done
+ * by the X server, so only the scaled down image is transferred. */
+GdkPixbuf*
+_wnck_gdk_pixbuf_get_scaled_from_pixmap (Screen *screen,
+                                         Pixmap  xpixmap,
+                                         int     max_width,
+                                         int     max_height)
+{
+  cairo_surface_t *surface, *scaled;
+  GdkPixbuf *retval;
+  int width, height;
+  double scale;
+  cairo_t *cr;
+
+  surface = _wnck_cairo_surface_get_from_pixmap (screen, xpixmap);
+
+  if (surface == NULL)
+    return NULL;
+
+  width = cairo_xlib_surface_get_width (surface);
+  height = cairo_xlib_surface_get_height (surface);
+
+  if (width <= 0 || height <= 0)
+    {
+      cairo_surface_destroy (surface);
+      return NULL;
+    }
+
+  scale = MIN ((double) max_width / width, (double) max_height / height);
+  scale = MIN (scale, 1.0);
+
+  width = MAX (1, width * scale + 0.5);
+  height = MAX (1, height * scale + 0.5);
+
+  scaled = cairo_surface_create_similar (surface, CAIRO_CONTENT_COLOR,
+                                         width, height);
+
+  cr = cairo_create (scaled);
+  cairo_scale (cr, scale, scale);
+  cairo_set_source_surface (cr, surface, 0, 0);
+  cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+  cairo_paint (cr);
+  cairo_destroy (cr);
+
+  cairo_surface_destroy (surface);
+
+  retval = gdk_pixbuf_get_from_surface (scaled, 0, 0, width, height);
+  cairo_surface_destroy (scaled);
+
+  return retval;
+}
+
 static gboolean
 try_pixmap_and_mask (Screen     *screen,
                      Pixmap      src_pixmap,
@@ -2378,13 +2782,13 @@ void _wnck_set_window_geometry (Screen *screen,
   xev.xclient.data.l[3] = width;
   xev.xclient.data.l[4] = height;
 
-  _wnck_error_trap_push (display);
+  _wnck_request_trap_push (display);
   XSendEvent (display,
               root,
               False,
               SubstructureRedirectMask | SubstructureNotifyMask,
               &xev);
-  _wnck_error_trap_pop (display);
+  _wnck_request_trap_pop (display);
 }
 
 void
@@ -2436,6 +2840,8 @@ _wnck_set_icon_geometry  (Screen *screen,
   data[2] = width;
   data[3] = height;
 
+  /* No need to sync: nobody cares if the window is already gone, and
+   * callers updating many windows at once only flush at the end. */
   _wnck_error_trap_push (display);
 
   XChangeProperty (display,
@@ -2444,7 +2850,7 @@ _wnck_set_icon_geometry  (Screen *screen,
 		   XA_CARDINAL, 32, PropModeReplace,
 		   (guchar *)&data, 4);
 
-  _wnck_error_trap_pop (display);
+  _wnck_error_trap_pop_ignored (display);
 }
 
 GdkDisplay*
@@ -2522,96 +2928,126 @@ _wnck_set_desktop_layout (Screen *xscreen,
   _wnck_error_trap_pop (display);
 }
 
+/* Claiming the _NET_DESKTOP_LAYOUT_Sn selection needs a real server
+ * timestamp. Instead of waiting for it in XIfEvent(), which blocks the main
+ * loop and hides every other event from GDK until the round trip is done,
+ * the claim is a small state machine: we write _TIMESTAMP_PROP on the
+ * manager window and go back to the main loop, and the claim is finished
+ * when the PropertyNotify comes through filter_func().
+ */
+typedef enum
+{
+  LAYOUT_MANAGER_WAITING_TIMESTAMP,
+  LAYOUT_MANAGER_OWNER
+} LayoutManagerState;
+
 typedef struct
 {
+  Display *display;
+  int screen_number;
+  int token;
   Window window;
+  Atom selection_atom;
+  Atom manager_atom;
   Atom timestamp_prop_atom;
-} TimeStampInfo;
 
-static Bool
-timestamp_predicate (Display *display,
-		     XEvent  *xevent,
-		     XPointer arg)
-{
-  TimeStampInfo *info = (TimeStampInfo *)arg;
+  LayoutManagerState state;
 
-  if (xevent->type == PropertyNotify &&
-      xevent->xproperty.window == info->window &&
-      xevent->xproperty.atom == info->timestamp_prop_atom)
-    return True;
+  WnckLayoutManagerFunc callback;
+  gpointer callback_data;
+  GDestroyNotify callback_destroy;
+} LayoutManager;
 
-  return False;
-}
+static GSList *layout_managers = NULL;
+static int next_token = 1;
 
-/**
- * get_server_time:
- * @display: display from which to get the time
- * @window: a #Window, used for communication with the server.
- *          The window must have PropertyChangeMask in its
- *          events mask or a hang will result.
- *
- * Routine to get the current X server time stamp.
- *
- * Return value: the time stamp.
- **/
-static Time
-get_server_time (Display *display,
-                 Window   window)
+static void
+layout_manager_clear_callback (LayoutManager *lm)
 {
-  unsigned char c = 'a';
-  XEvent xevent;
-  TimeStampInfo info;
-
-  info.timestamp_prop_atom = _wnck_atom_get ("_TIMESTAMP_PROP");
-  info.window = window;
-
-  XChangeProperty (display, window,
-		   info.timestamp_prop_atom, info.timestamp_prop_atom,
-		   8, PropModeReplace, &c, 1);
+  if (lm->callback_destroy)
+    lm->callback_destroy (lm->callback_data);
 
-  XIfEvent (display, &xevent,
-	    timestamp_predicate, (XPointer)&info);
-
-  return xevent.xproperty.time;
+  lm->callback = NULL;
+  lm->callback_data = NULL;
+  lm->callback_destroy = NULL;
 }
 
-typedef struct
+static void
+layout_manager_complete (LayoutManager *lm,
+                         gboolean       claimed)
 {
-  Display *display;
-  int screen_number;
+  WnckLayoutManagerFunc callback;
+  gpointer callback_data;
+  GDestroyNotify callback_destroy;
   int token;
-  Window window;
-  Atom selection_atom;
-  Atom manager_atom;
-} LayoutManager;
 
-static GSList *layout_managers = NULL;
-static int next_token = 1;
+  callback = lm->callback;
+  callback_data = lm->callback_data;
+  callback_destroy = lm->callback_destroy;
+  token = lm->token;
+
+  lm->callback = NULL;
+  lm->callback_data = NULL;
+  lm->callback_destroy = NULL;
+
+  /* lm might be freed by the callback, through
+   * _wnck_release_desktop_layout_manager(), so do not use it after this */
+  if (callback)
+    callback (token, claimed, callback_data);
+
+  if (callback_destroy)
+    callback_destroy (callback_data);
+}
 
 static void
 _wnck_free_layout_manager (LayoutManager *lm)
 {
+  layout_managers = g_slist_remove (layout_managers, lm);
+
+  /* Destroying the window releases the selection if we own it */
   _wnck_error_trap_push (lm->display);
   XDestroyWindow (lm->display, lm->window);
   _wnck_error_trap_pop (lm->display);
 
-  g_slice_free (LayoutManager, lm);
+  layout_manager_clear_callback (lm);
 
-  layout_managers = g_slist_remove (layout_managers, lm);
+  g_slice_free (LayoutManager, lm);
 }
 
+/**
+ * _wnck_try_desktop_layout_manager:
+ * @xscreen: the #Screen on which to claim the layout selection.
+ * @current_token: a token obtained by a previous call, or
+ * %WNCK_NO_MANAGER_TOKEN.
+ * @callback: function to call once we know whether we own the selection.
+ * @callback_data: data to pass to @callback.
+ * @callback_destroy: function to free @callback_data, or %NULL.
+ *
+ * Tries to become the owner of the desktop layout selection, without waiting
+ * for the X server. If @current_token still owns the selection, @callback is
+ * called before returning. If a new claim is started, or if the claim of
+ * @current_token is still in progress, @callback is called once the claim
+ * completes; a claim still in progress only keeps the last callback. When
+ * %WNCK_NO_MANAGER_TOKEN is returned, @callback is never called.
+ *
+ * Return value: the token of the layout manager, or %WNCK_NO_MANAGER_TOKEN if
+ * someone else owns the selection.
+ **/
 int
-_wnck_try_desktop_layout_manager (Screen *xscreen,
-                                  int     current_token)
+_wnck_try_desktop_layout_manager (Screen                *xscreen,
+                                  int                    current_token,
+                                  WnckLayoutManagerFunc  callback,
+                                  gpointer               callback_data,
+                                  GDestroyNotify         callback_destroy)
 {
   Display *display;
   Window root;
   Atom selection_atom;
   Window owner;
   GSList *tmp;
+  gboolean taken;
   int number;
-  Time timestamp;
-  XClientMessageEvent xev;
+  unsigned char c = 'a';
   char buffer[256];
   LayoutManager *lm;
 
@@ -2622,7 +3058,8 @@ _wnck_try_desktop_layout_manager (Screen *xscreen,
   sprintf (buffer, "_NET_DESKTOP_LAYOUT_S%d", number);
   selection_atom = _wnck_atom_get (buffer);
 
-  owner = XGetSelectionOwner (display, selection_atom);
+  /* whether another token of this process has the selection */
+  taken = FALSE;
 
   tmp = layout_managers;
   while (tmp != NULL)
@@ -2632,25 +3069,55 @@ _wnck_try_desktop_layout_manager (Screen *xscreen,
       if (display == lm->display &&
           number == lm->screen_number)
         {
-          if (current_token == lm->token)
+          if (current_token != lm->token)
+            {
+              taken = TRUE;
+              break;
+            }
+
+          if (lm->state == LAYOUT_MANAGER_WAITING_TIMESTAMP)
             {
-              if (owner == lm->window)
-                return current_token; /* we still have the selection */
-              else
-                { /* we lost the selection */
-                  _wnck_free_layout_manager (lm);
-                  break;
-                }
+              /* the claim is still in progress: only the last request
+               * matters */
+              layout_manager_clear_callback (lm);
+              lm->callback = callback;
+              lm->callback_data = callback_data;
+              lm->callback_destroy = callback_destroy;
+
+              return current_token;
             }
-          else
-            return WNCK_NO_MANAGER_TOKEN; /* someone else has it */
+
+          owner = XGetSelectionOwner (display, selection_atom);
+
+          if (owner == lm->window)
+            {
+              /* we still have the selection */
+              if (callback)
+                callback (current_token, TRUE, callback_data);
+              if (callback_destroy)
+                callback_destroy (callback_data);
+
+              return current_token;
+            }
+
+          /* we lost the selection: try to claim it again below */
+          _wnck_free_layout_manager (lm);
+          lm = NULL;
+          break;
         }
 
       tmp = tmp->next;
     }
 
-  if (owner != None)
-    return WNCK_NO_MANAGER_TOKEN; /* someone else has the selection */
+  if (taken ||
+      XGetSelectionOwner (display, selection_atom) != None)
+    {
+      /* someone else has the selection */
+      if (callback_destroy)
+        callback_destroy (callback_data);
+
+      return WNCK_NO_MANAGER_TOKEN;
+    }
 
   /* No one has the selection at the moment */
 
@@ -2663,6 +3130,12 @@ _wnck_try_desktop_layout_manager (Screen *xscreen,
 
   lm->selection_atom = selection_atom;
   lm->manager_atom = _wnck_atom_get ("MANAGER");
+  lm->timestamp_prop_atom = _wnck_atom_get ("_TIMESTAMP_PROP");
+
+  lm->state = LAYOUT_MANAGER_WAITING_TIMESTAMP;
+  lm->callback = callback;
+  lm->callback_data = callback_data;
+  lm->callback_destroy = callback_destroy;
 
   _wnck_error_trap_push (display);
 
@@ -2673,22 +3146,50 @@ _wnck_try_desktop_layout_manager (Screen *xscreen,
                                     WhitePixel (display, number));
 
   XSelectInput (display, lm->window, PropertyChangeMask);
-  timestamp = get_server_time (display, lm->window);
 
-  XSetSelectionOwner (display, lm->selection_atom,
-		      lm->window, timestamp);
+  /* The PropertyNotify event for this change gives us the server time we
+   * need to claim the selection; see layout_manager_finish_claim() */
+  XChangeProperty (display, lm->window,
+                   lm->timestamp_prop_atom, lm->timestamp_prop_atom,
+                   8, PropModeReplace, &c, 1);
 
-  _wnck_error_trap_pop (display);
+  _wnck_error_trap_pop_ignored (display);
+
+  layout_managers = g_slist_prepend (layout_managers,
+                                     lm);
+
+  return lm->token;
+}
+
+static void
+layout_manager_finish_claim (LayoutManager *lm,
+                             Time           timestamp)
+{
+  Window root;
+  XClientMessageEvent xev;
+
+  _wnck_error_trap_push (lm->display);
+  XSetSelectionOwner (lm->display, lm->selection_atom,
+                      lm->window, timestamp);
+  _wnck_error_trap_pop (lm->display);
 
   /* Check to see if we managed to claim the selection. */
 
-  if (XGetSelectionOwner (display, lm->selection_atom) !=
+  if (XGetSelectionOwner (lm->display, lm->selection_atom) !=
       lm->window)
     {
-      g_free (lm);
-      return WNCK_NO_MANAGER_TOKEN;
+      /* unlist lm first so that the callback cannot release it */
+      layout_managers = g_slist_remove (layout_managers, lm);
+      layout_manager_complete (lm, FALSE);
+      _wnck_free_layout_manager (lm);
+
+      return;
     }
 
+  lm->state = LAYOUT_MANAGER_OWNER;
+
+  root = RootWindow (lm->display, lm->screen_number);
+
   xev.type = ClientMessage;
   xev.window = root;
   xev.message_type = lm->manager_atom;
@@ -2699,15 +3200,12 @@ _wnck_try_desktop_layout_manager (Screen *xscreen,
   xev.data.l[3] = 0;	/* manager specific data */
   xev.data.l[4] = 0;	/* manager specific data */
 
-  _wnck_error_trap_push (display);
-  XSendEvent (display, root,
+  _wnck_error_trap_push (lm->display);
+  XSendEvent (lm->display, root,
               False, StructureNotifyMask, (XEvent *)&xev);
-  _wnck_error_trap_pop (display);
-
-  layout_managers = g_slist_prepend (layout_managers,
-                                     lm);
+  _wnck_error_trap_pop (lm->display);
 
-  return lm->token;
+  layout_manager_complete (lm, TRUE);
 }
 
 void
@@ -2732,21 +3230,10 @@ _wnck_release_desktop_layout_manager (Screen *xscreen,
         {
           if (current_token == lm->token)
             {
-              _wnck_error_trap_push (display);
-
-              /* release selection ownership */
-              if (XGetSelectionOwner (display, lm->selection_atom) !=
-                  lm->window)
-                {
-                  Time timestamp;
-
-                  timestamp = get_server_time (display, lm->window);
-                  XSetSelectionOwner (display, lm->selection_atom,
-                                      None, timestamp);
-                }
-
-              _wnck_error_trap_pop (display);
-
+              /* The selection owner reverts to None when its window is
+               * destroyed, so there is no need to ask the server for a
+               * timestamp here. A claim still in progress is simply
+               * dropped: its PropertyNotify will not match anything. */
               _wnck_free_layout_manager (lm);
               return;
             }
@@ -2762,7 +3249,7 @@ _wnck_desktop_layout_manager_process_event (XEvent *xev)
   GSList *tmp;
   LayoutManager *lm;
 
-  if (xev->type != SelectionClear)
+  if (xev->type != SelectionClear && xev->type != PropertyNotify)
     return FALSE;
 
   tmp = layout_managers;
@@ -2771,11 +3258,21 @@ _wnck_desktop_layout_manager_process_event (XEvent *xev)
       lm = tmp->data;
 
       if (xev->xany.display == lm->display &&
-          xev->xany.window == lm->window &&
-          xev->xselectionclear.selection == lm->selection_atom)
+          xev->xany.window == lm->window)
         {
-          _wnck_free_layout_manager (lm);
-          return TRUE;
+          if (xev->type == PropertyNotify)
+            {
+              if (lm->state == LAYOUT_MANAGER_WAITING_TIMESTAMP &&
+                  xev->xproperty.atom == lm->timestamp_prop_atom)
+                layout_manager_finish_claim (lm, xev->xproperty.time);
+
+              return TRUE;
+            }
+          else if (xev->xselectionclear.selection == lm->selection_atom)
+            {
+              _wnck_free_layout_manager (lm);
+              return TRUE;
+            }
         }
 
       tmp = tmp->next;
@@ -86,8 +86,9 @@ void     _wnck_set_utf8_list     (Screen  *screen,
                                   Atom     atom,
                                   char   **list);
 
-void _wnck_error_trap_push (Display *display);
-int  _wnck_error_trap_pop  (Display *display);
+void _wnck_error_trap_push        (Display *display);
+int  _wnck_error_trap_pop         (Display *display);
+void _wnck_error_trap_pop_ignored (Display *display);
 
 #define _wnck_atom_get(atom_name) gdk_x11_get_xatom_by_name (atom_name)
 #define _wnck_atom_name(atom)     gdk_x11_get_xatom_name (atom)
@@ -99,6 +100,11 @@ int   _wnck_xid_equal (gconstpointer v1,
                        gconstpointer v2);
 guint _wnck_xid_hash  (gconstpointer v);
 
+void _wnck_begin_request_batch (Display *display);
+void _wnck_end_request_batch   (Display *display);
+void _wnck_request_trap_push   (Display *display);
+void _wnck_request_trap_pop    (Display *display);
+
 void _wnck_iconify   (Screen *screen,
                       Window  xwindow);
 void _wnck_deiconify (Screen *screen,
@@ -134,6 +140,25 @@ char*  _wnck_get_name           (Screen *screen,
                                  Window  xwindow);
 char*  _wnck_get_icon_name      (Screen *screen,
                                  Window  xwindow);
+
+/* the properties a name is read from, in order of preference */
+typedef enum
+{
+  WNCK_NAME_PROPERTY_UNKNOWN,
+  WNCK_NAME_PROPERTY_VISIBLE, /* _NET_WM_VISIBLE_NAME */
+  WNCK_NAME_PROPERTY_NET,     /* _NET_WM_NAME */
+  WNCK_NAME_PROPERTY_ICCCM,   /* WM_NAME */
+  WNCK_NAME_PROPERTY_NONE
+} _WnckNameProperty;
+
+char*  _wnck_get_name_from      (Screen            *screen,
+                                 Window             xwindow,
+                                 _WnckNameProperty *property);
+char*  _wnck_get_icon_name_from (Screen            *screen,
+                                 Window             xwindow,
+                                 _WnckNameProperty *property);
+_WnckNameProperty _wnck_name_property_from_atom (Atom     atom,
+                                                 gboolean icon_name);
 char*  _wnck_get_res_class_utf8 (Screen *screen,
                                  Window  xwindow);
 void   _wnck_get_wmclass        (Screen *screen,
@@ -222,6 +247,10 @@ void _wnck_set_desktop_layout (Screen *xscreen,
 
 GdkPixbuf* _wnck_gdk_pixbuf_get_from_pixmap (Screen *screen,
                                              Pixmap  xpixmap);
+GdkPixbuf* _wnck_gdk_pixbuf_get_scaled_from_pixmap (Screen *screen,
+                                                    Pixmap  xpixmap,
+                                                    int     max_width,
+                                                    int     max_height);
 
 GdkDisplay* _wnck_gdk_display_lookup_from_display (Display *display);
 
@@ -230,8 +259,15 @@ GdkWindow* _wnck_gdk_window_lookup_from_window (Screen *screen,
 
 #define WNCK_NO_MANAGER_TOKEN 0
 
-int      _wnck_try_desktop_layout_manager           (Screen *xscreen,
-                                                     int     current_token);
+typedef void (* WnckLayoutManagerFunc) (int      token,
+                                        gboolean claimed,
+                                        gpointer user_data);
+
+int      _wnck_try_desktop_layout_manager           (Screen                *xscreen,
+                                                     int                    current_token,
+                                                     WnckLayoutManagerFunc  callback,
+                                                     gpointer               callback_data,
+                                                     GDestroyNotify         callback_destroy);
 void     _wnck_release_desktop_layout_manager       (Screen *xscreen,
                                                      int     current_token);
 gboolean _wnck_desktop_layout_manager_process_event (XEvent *xev);